@@ -0,0 +1,210 @@
+#include "bvh.h"
+#include "camera.h"
+#include "object.h"
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+void SceneBVH::update(const std::vector<MeshComponent *> &meshes) {
+    if (!dirty)
+        return;
+    dirty = false;
+
+    // Comparing the pointers with the items' isn't enough, a new component can be allocated where a freed one was
+    if (rebuild || meshes.size() != items.size()) {
+        rebuild = false;
+        changed.clear(); // May point to freed components
+        items.resize(meshes.size());
+        itemIndices.clear();
+        for (size_t i = 0; i < items.size(); i++) {
+            items[i] = {meshes[i], meshes[i]->worldBounds()};
+            itemIndices[meshes[i]] = i;
+        }
+        leafItems.resize(items.size());
+        std::iota(leafItems.begin(), leafItems.end(), 0);
+        itemLeaves.resize(items.size());
+        nodes.clear();
+        parents.clear();
+        if (!items.empty())
+            build(0, items.size(), 0);
+        // Children always come after their parent, so going backwards visits them first
+        for (size_t i = nodes.size(); i-- > 0;)
+            refit(i);
+        return;
+    }
+
+    // Each changed item's leaf and its ancestors, children before parents
+    stale.clear();
+    for (MeshComponent *mesh : changed) {
+        auto it = itemIndices.find(mesh);
+        if (it == itemIndices.end())
+            continue;
+        items[it->second].bounds = mesh->worldBounds();
+        for (uint32_t node = itemLeaves[it->second];; node = parents[node]) {
+            stale.push_back(node);
+            if (node == 0)
+                break;
+        }
+    }
+    changed.clear();
+    std::sort(stale.begin(), stale.end(), std::greater<>());
+    stale.erase(std::unique(stale.begin(), stale.end()), stale.end());
+    for (uint32_t node : stale)
+        refit(node);
+}
+
+// Top down, splits at the median center along the longest axis of the centers
+uint32_t SceneBVH::build(uint32_t start, uint32_t end, uint32_t parent) {
+    uint32_t index = nodes.size();
+    nodes.push_back(Node{.start = start, .count = end - start, .right = 0});
+    parents.push_back(parent);
+    if (end - start <= leafSize) {
+        for (uint32_t i = start; i < end; i++)
+            itemLeaves[leafItems[i]] = index;
+        return index;
+    }
+
+    auto &&center = [&](uint32_t item) { return (items[item].bounds.min + items[item].bounds.max) / 2; };
+    Vec3 min = center(leafItems[start]), max = min;
+    for (uint32_t i = start; i < end; i++) {
+        Vec3 c = center(leafItems[i]);
+        min = {std::min(min.x, c.x), std::min(min.y, c.y), std::min(min.z, c.z)};
+        max = {std::max(max.x, c.x), std::max(max.y, c.y), std::max(max.z, c.z)};
+    }
+    Vec3 extent = max - min;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+
+    uint32_t mid = (start + end) / 2;
+    std::nth_element(leafItems.begin() + start, leafItems.begin() + mid, leafItems.begin() + end, [&](uint32_t a, uint32_t b) {
+        Vec3 ca = center(a), cb = center(b);
+        return (&ca.x)[axis] < (&cb.x)[axis];
+    });
+
+    nodes[index].count = 0;
+    build(start, mid, index);
+    uint32_t right = build(mid, end, index);
+    nodes[index].right = right;
+    return index;
+}
+
+// From the node's items, or its children's bounds, so those have to be refitted first
+void SceneBVH::refit(uint32_t i) {
+    Node &node = nodes[i];
+    node.min = {INFINITY, INFINITY, INFINITY};
+    node.max = {-INFINITY, -INFINITY, -INFINITY};
+    auto &&add = [&](Vec3 min, Vec3 max) {
+        node.min = {std::min(node.min.x, min.x), std::min(node.min.y, min.y), std::min(node.min.z, min.z)};
+        node.max = {std::max(node.max.x, max.x), std::max(node.max.y, max.y), std::max(node.max.z, max.z)};
+    };
+    if (node.count) {
+        for (uint32_t j = node.start; j < node.start + node.count; j++)
+            if (items[leafItems[j]].bounds.radius >= 0)
+                add(items[leafItems[j]].bounds.min, items[leafItems[j]].bounds.max);
+    } else {
+        add(nodes[i + 1].min, nodes[i + 1].max);
+        add(nodes[node.right].min, nodes[node.right].max);
+    }
+}
+
+void SceneBVH::cull(Camera *camera, std::vector<MeshComponent *> &out) const {
+    thread_local std::vector<uint32_t> visible;
+    visible.clear();
+    out.clear();
+    if (nodes.empty())
+        return;
+
+    uint32_t stack[maxDepth];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize) {
+        uint32_t index = stack[--stackSize];
+        const Node &node = nodes[index];
+        if (node.min.x > node.max.x || !camera->boxInFrustum(node.min, node.max))
+            continue;
+        if (node.count) {
+            for (uint32_t j = node.start; j < node.start + node.count; j++)
+                if (camera->boundsInFrustum(items[leafItems[j]].bounds))
+                    visible.push_back(leafItems[j]);
+        } else {
+            stack[stackSize++] = node.right;
+            stack[stackSize++] = index + 1;
+        }
+    }
+
+    // Keep the scene tree order, so triangles are drawn in the same order as without culling
+    std::sort(visible.begin(), visible.end());
+    for (uint32_t i : visible)
+        out.push_back(items[i].mesh);
+}
+
+// Distance along the ray where it enters the box, or INFINITY if it misses it
+static float rayBoxDistance(Vec3 origin, Vec3 inverseDirection, Vec3 min, Vec3 max) {
+    float near = 0, far = INFINITY;
+    for (int axis = 0; axis < 3; axis++) {
+        float o = (&origin.x)[axis], inv = (&inverseDirection.x)[axis];
+        float t1 = ((&min.x)[axis] - o) * inv, t2 = ((&max.x)[axis] - o) * inv;
+        if (std::isnan(t1) || std::isnan(t2)) // Parallel to this axis and on a face of the box
+            continue;
+        near = std::max(near, std::min(t1, t2));
+        far = std::min(far, std::max(t1, t2));
+    }
+    return near <= far ? near : INFINITY;
+}
+
+// Möller-Trumbore. det is negative for faces the rasterizer considers back faces.
+static float rayTriangleDistance(Vec3 origin, Vec3 direction, Vec3 a, Vec3 b, Vec3 c, bool frontOnly) {
+    Vec3 edge1 = b - a, edge2 = c - a;
+    Vec3 p = direction.cross(edge2);
+    float det = edge1.dot(p);
+    if (std::abs(det) < 1e-12f || (frontOnly && det < 0))
+        return INFINITY;
+    float invDet = 1 / det;
+    Vec3 s = origin - a;
+    float u = s.dot(p) * invDet;
+    if (u < 0 || u > 1)
+        return INFINITY;
+    Vec3 q = s.cross(edge1);
+    float v = direction.dot(q) * invDet;
+    if (v < 0 || u + v > 1)
+        return INFINITY;
+    float t = edge2.dot(q) * invDet;
+    return t > 0 ? t : INFINITY;
+}
+
+Face *SceneBVH::raycast(Vec3 origin, Vec3 direction, float maxDistance, bool backFaceCulling) const {
+    Face *hit = nullptr;
+    if (nodes.empty())
+        return hit;
+    Vec3 inverseDirection{1 / direction.x, 1 / direction.y, 1 / direction.z};
+
+    uint32_t stack[maxDepth];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize) {
+        uint32_t index = stack[--stackSize];
+        const Node &node = nodes[index];
+        if (node.min.x > node.max.x || rayBoxDistance(origin, inverseDirection, node.min, node.max) >= maxDistance)
+            continue;
+        if (!node.count) {
+            stack[stackSize++] = node.right;
+            stack[stackSize++] = index + 1;
+            continue;
+        }
+        for (uint32_t j = node.start; j < node.start + node.count; j++) {
+            const Item &item = items[leafItems[j]];
+            if (item.bounds.radius < 0 || rayBoxDistance(origin, inverseDirection, item.bounds.min, item.bounds.max) >= maxDistance)
+                continue;
+            Mesh &mesh = *item.mesh->mesh;
+            const Vec3Stream &positions = item.mesh->worldVertices().positions;
+            for (Face &face : mesh.faces) {
+                bool frontOnly = backFaceCulling && !(face.material->flags.transparent || face.material->flags.doubleSided);
+                float t = rayTriangleDistance(origin, direction, positions[face.v1], positions[face.v2], positions[face.v3], frontOnly);
+                if (t < maxDistance) {
+                    maxDistance = t;
+                    hit = &face;
+                }
+            }
+        }
+    }
+    return hit;
+}
@@ -0,0 +1,60 @@
+#ifndef __BVH_H__
+#define __BVH_H__
+
+#include "miscTypes.h"
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Camera;
+class MeshComponent;
+
+// Bounding volume hierarchy over the mesh components of a scene, shared by all of its cameras and shadow maps.
+// Only rebuilt when mesh components are added or removed, otherwise only the bounds of the components that moved
+// or changed, and of the nodes above them, are refitted in place.
+class SceneBVH {
+  public:
+    // Call when the transform or the mesh of a component changed, the next update refits the nodes above it
+    void invalidate(MeshComponent *mesh) {
+        changed.push_back(mesh);
+        dirty = true;
+    }
+    // Call when mesh components are added or removed, the next update rebuilds the tree. Until then the items
+    // may point to freed components, so it must not be used before the update. Scene::invalidateRenderList calls this.
+    void invalidateItems() { dirty = rebuild = true; }
+    // Rebuilds the tree after invalidateItems, otherwise refits it
+    void update(const std::vector<MeshComponent *> &meshes);
+    // Mesh components that may be visible to the camera, in scene tree order
+    void cull(Camera *camera, std::vector<MeshComponent *> &out) const;
+    // Closest face hit by the ray, or nullptr. Distances are in multiples of direction.
+    // With backFaceCulling, faces the rasterizer would cull are ignored.
+    Face *raycast(Vec3 origin, Vec3 direction, float maxDistance = INFINITY, bool backFaceCulling = true) const;
+
+  private:
+    struct Node {
+        Vec3 min, max;
+        uint32_t start, count; // Range of leafItems, count is 0 for inner nodes
+        uint32_t right;        // Index of the right child, the left child is the next node
+    };
+    struct Item {
+        MeshComponent *mesh;
+        Bounds bounds;
+    };
+    std::vector<Node> nodes;
+    std::vector<Item> items;         // In scene tree order
+    std::vector<uint32_t> leafItems; // Indices of items, grouped by leaf
+    std::vector<uint32_t> parents;   // Of each node, the root's is itself
+    std::vector<uint32_t> itemLeaves; // Leaf node of each item
+    std::unordered_map<MeshComponent *, uint32_t> itemIndices;
+    std::vector<MeshComponent *> changed; // Since the last update, may repeat
+    std::vector<uint32_t> stale;          // Nodes to refit, reused by update
+    bool dirty = true, rebuild = true;
+    static constexpr uint32_t leafSize = 4;
+    static constexpr int maxDepth = 64; // Splits are at the median, so this is never reached
+
+    uint32_t build(uint32_t start, uint32_t end, uint32_t parent);
+    void refit(uint32_t node);
+};
+
+#endif /* __BVH_H__ */
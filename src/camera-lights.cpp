@@ -0,0 +1,97 @@
+#include "camera.h"
+#include "data.h"
+#include "light.h"
+#include <algorithm>
+#include <cmath>
+
+bool Camera::lightClusterRange(Light *light, ClusterRange &range) {
+    float radius = light->reach();
+    float S = 1 / tanHalfFov; // Scale of clip space x and y
+    // Negated clip space x, y and w are the screen position times the depth, and the depth, see projectionFromClip
+    Vec3 center = -transformProjective(light->obj->globalPosition, projectionMatrix);
+    float nearDepth = center.z - radius, farDepth = center.z + radius;
+    if(farDepth <= 0 || nearDepth >= farClip)
+        return false;
+
+    Vector2u size = frame->size;
+    float screenMin[2], screenMax[2];
+    for (int axis = 0; axis < 2; axis++) {
+        float a = (axis ? center.y : center.x) - S * radius, b = (axis ? center.y : center.x) + S * radius;
+        if(orthographic) {
+            screenMin[axis] = a;
+            screenMax[axis] = b;
+        }
+        else if(nearDepth <= 0) { // Around the camera, it can be anywhere on the screen
+            screenMin[axis] = -1;
+            screenMax[axis] = 1;
+        }
+        else { // The sphere's bounding box in view space projects inside the projections of its corners
+            screenMin[axis] = std::min(a / nearDepth, a / farDepth);
+            screenMax[axis] = std::max(b / nearDepth, b / farDepth);
+        }
+        if(screenMax[axis] < -1 || screenMin[axis] > 1)
+            return false;
+    }
+    // To tiles, the same way toScreen goes to pixels
+    auto &&tile = [&](float screen, int axis) {
+        float pixel = std::clamp((screen + 1) * (axis ? size.y : size.x) / 2.0f, 0.0f, (float)(axis ? size.y : size.x) - 1);
+        return (uint)pixel / RenderTarget::tileSize;
+    };
+    range = {
+        .minX = tile(screenMin[0], 0), .maxX = tile(screenMax[0], 0),
+        .minY = tile(screenMin[1], 1), .maxY = tile(screenMax[1], 1),
+        .minSlice = lightClusters.slice(nearDepth), .maxSlice = lightClusters.slice(farDepth),
+    };
+    return true;
+}
+
+void Camera::buildLightClusters(Scene &scene) {
+    LightClusters &clusters = lightClusters;
+    clusters.tileCount = frame->tileCount;
+    clusters.nearClip = nearClip;
+    clusters.sliceScale = LightClusters::depthSlices / std::log(farClip / nearClip);
+    size_t tiles = clusters.tileCount.x * clusters.tileCount.y;
+    size_t clusterCount = tiles * LightClusters::depthSlices;
+    auto &&cluster = [&](uint x, uint y, uint slice) { return (y * clusters.tileCount.x + x) * LightClusters::depthSlices + slice; };
+
+    // Count the lights of each cluster, then each one's list starts where the previous ones end, and they're filled in scene order
+    clusters.unbounded.clear();
+    clusters.offsets.assign(clusterCount + 1, 0);
+    ClusterRange range;
+    for (Light *light : scene.lights) {
+        if(light->reach() == INFINITY)
+            clusters.unbounded.push_back(light);
+        else if(lightClusterRange(light, range))
+            for (uint y = range.minY; y <= range.maxY; y++)
+                for (uint x = range.minX; x <= range.maxX; x++)
+                    for (uint slice = range.minSlice; slice <= range.maxSlice; slice++)
+                        clusters.offsets[cluster(x, y, slice) + 1]++;
+    }
+    for (size_t i = 0; i < clusterCount; i++)
+        clusters.offsets[i + 1] += clusters.offsets[i];
+    clusters.lights.resize(clusters.offsets[clusterCount]);
+
+    std::vector<uint32_t> &next = clusters.next;
+    next.assign(clusters.offsets.begin(), clusters.offsets.end() - 1);
+    for (Light *light : scene.lights)
+        if(light->reach() != INFINITY && lightClusterRange(light, range))
+            for (uint y = range.minY; y <= range.maxY; y++)
+                for (uint x = range.minX; x <= range.maxX; x++)
+                    for (uint slice = range.minSlice; slice <= range.maxSlice; slice++)
+                        clusters.lights[next[cluster(x, y, slice)]++] = light;
+}
+
+std::span<Light *const> Camera::clusterLights(sf::Vector2i pixel, float z) const {
+    const LightClusters &clusters = lightClusters;
+    uint x = std::min((uint)std::max(pixel.x, 0) / RenderTarget::tileSize, clusters.tileCount.x - 1);
+    uint y = std::min((uint)std::max(pixel.y, 0) / RenderTarget::tileSize, clusters.tileCount.y - 1);
+    size_t cluster = (y * clusters.tileCount.x + x) * LightClusters::depthSlices + clusters.slice(z);
+    return {clusters.lights.data() + clusters.offsets[cluster], clusters.lights.data() + clusters.offsets[cluster + 1]};
+}
+
+std::span<Light *const> Camera::clusterLights(Vec3 worldPos) {
+    Vec3 screenPos = perspectiveProject(worldPos).screenPos;
+    // Like toScreen, written so NaN, at the camera's position, goes to 0
+    auto &&pixel = [](float screen, uint size) { return (int)std::min(std::max(0.0f, (screen + 1) * size / 2.0f), size - 1.0f); };
+    return clusterLights(sf::Vector2i{pixel(screenPos.x, frame->size.x), pixel(screenPos.y, frame->size.y)}, screenPos.z);
+}
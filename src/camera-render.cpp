@@ -13,140 +13,325 @@
 #include <functional>
 #include <SFML/System/Clock.hpp>
 #include <memory>
+#include <optional>
+#include <stdexcept>
 #include <typeindex>
 
 void Camera::render() {
     shared_ptr<Scene> scene = obj->scene.lock();
     if(!scene) return;
+    renderScene = scene.get();
+    scene->bvh.update(scene->renderList());
 
     maximumColor = 0;
 
+    transparents.clear();
+
     if(shadowMap) {
         makePerspectiveProjectionMatrix();
 
-        std::fill(frame->zBuffer.begin(), frame->zBuffer.end(), INFINITY);
-
-        std::vector<Triangle> triangles;
-        std::vector<TransparentTriangle> transparents;
+        frame->clearDepth();
 
-        buildTriangles(transparents, triangles);
+        buildTriangles();
 
-        for (auto &&tri : triangles)
-            drawTriangle(this, tri, frame->deferred);
+        drawTriangles(TriangleList::Opaque, DrawMode::DepthOnly);
     } 
     else {
-        timing.clock.restart();
+        sf::Clock clock; // Not timing.clock, the window loop keeps using that while the render thread renders
 
         makePerspectiveProjectionMatrix();
-        std::fill(frame->zBuffer.begin(), frame->zBuffer.end(), INFINITY);
+        frame->clearDepth();
         if(frame->deferred) {
             for (Fragment &f : frame->gBuffer)
                 f.z = INFINITY;
-            std::fill(frame->transparencyHeads.begin(), frame->transparencyHeads.end(), (uint32_t)-1);
-            frame->transparencyFragments.clear();
+            std::fill(frame->packedGBuffer.face.begin(), frame->packedGBuffer.face.end(), nullptr);
+            std::fill(frame->visibility.begin(), frame->visibility.end(), UINT32_MAX);
         }
         else
             drawSkyBox();
 
-        timing.skyBoxTime.push(timing.clock);
-
+        timing.skyBoxTime.push(clock);
 
-        std::vector<Triangle> triangles;
-        std::vector<TransparentTriangle> transparents;
-        buildTriangles(transparents, triangles);
 
-        timing.renderPrepareTime.push(timing.clock);
+        buildLightClusters(*scene);
+        buildTriangles();
 
+        timing.renderPrepareTime.push(clock);
 
-        for (auto &&tri : triangles)
-            drawTriangle(this, tri, frame->deferred);
 
         if(frame->deferred)
-            for (auto &&tri : transparents)
-                drawTriangle(this, tri.tri, true);
+            drawTriangles(TriangleList::Opaque, frame->gBufferLayout == GBufferLayout::Visibility ? DrawMode::Visibility : DrawMode::Deferred);
+        else if(frame->depthPrePass) {
+            // Shade each pixel once, instead of once for every surface that was the closest when it was drawn
+            binTriangles(TriangleList::Opaque);
+            drawBinned(DrawMode::DepthOnly);
+            drawBinned(DrawMode::DepthEqual);
+        }
+        else
+            drawTriangles(TriangleList::Opaque, DrawMode::Forward);
+
+        bool weightedBlended = scene->transparencyMode == TransparencyMode::WeightedBlended;
+        if(!weightedBlended && !frame->deferred) {
+            // Each tile keeps the sorted order, so these are still blended back to front
+            auto &&compareZ = [](TransparentTriangle &a, TransparentTriangle &b){ return a.z > b.z; };
+            std::sort(transparents.begin(), transparents.end(), compareZ);
+        }
 
-        timing.geometryTime.push(timing.clock);
+        if(weightedBlended) {
+            // Order doesn't matter, so these are shaded right away, even in deferred mode
+            if(frame->deferred)
+                frame->clearTransparency();
+            frame->transparencyAccumulation.assign(frame->size.x * frame->size.y, Color{0, 0, 0, 0});
+            frame->transparencyRevealage.assign(frame->size.x * frame->size.y, Color{1, 1, 1, 1});
+            drawTriangles(TriangleList::Transparent, DrawMode::WeightedBlended);
+        }
+        else if(frame->deferred) {
+            // The fragment pool can't grow while threads are allocating from it, so if it ran out, grow it and draw again
+            binTriangles(TriangleList::Transparent);
+            while (true) {
+                frame->clearTransparency();
+                drawBinned(DrawMode::Deferred);
+                if (frame->transparencyFragmentCount <= frame->transparencyFragments.size())
+                    break;
+                frame->transparencyFragments.resize(frame->transparencyFragmentCount * 3 / 2);
+            }
+        }
+
+        timing.geometryTime.push(clock);
 
 
         // Deferred pass
         if(frame->deferred)
-            startThreads(this, false);
+            startThreads(this, ThreadJob::Deferred);
 
-        timing.lightingTime.push(timing.clock);
+        timing.lightingTime.push(clock);
 
-        if(!frame->deferred) {
-            auto &&compareZ = [](TransparentTriangle &a, TransparentTriangle &b){ return a.z > b.z; };
-            std::sort(transparents.begin(), transparents.end(), compareZ);
-            for (auto &&tri : transparents)
-                drawTriangle(this, tri.tri, false);
-        }
+        if(weightedBlended)
+            startThreads(this, ThreadJob::TransparencyResolve);
+        else if(!frame->deferred)
+            drawTriangles(TriangleList::Transparent, DrawMode::Forward);
         
-        timing.forwardTime.push(timing.clock);
-        timing.clock.stop();
+        timing.forwardTime.push(clock);
 
 
         if(scene->volume)
-            startThreads(this, true); // Even if deferred rendering is disabled, this can be multithreaded
+            startThreads(this, ThreadJob::Fog); // Even if deferred rendering is disabled, this can be multithreaded
     }
 }
 
-void Camera::buildTriangles(
-    std::vector<TransparentTriangle> &transparents,
-    std::vector<Triangle> &triangles
-) {
-    shared_ptr<Scene> scene = obj->scene.lock();
-    std::function<void(shared_ptr<Object>)> handleObject = [&](shared_ptr<Object> obj) {
-        for (auto &&comp : obj->components) {
-            if (MeshComponent *meshComp = dynamic_cast<MeshComponent *>(comp.get())) {
-                shared_ptr<Mesh> mesh = meshComp->mesh;
-                Projection projectedVertices[mesh->vertices.size()];
-
-                for (size_t j = 0; j < mesh->vertices.size(); j++) {
-                    Vertex vV = mesh->vertices[j];
-
-                    projectedVertices[j] = perspectiveProject(vV.position * obj->transform);
-                    auto normal = (vV.normal * obj->transformNormals).normalized();
-                    projectedVertices[j].normal = normal;
-                }
+// Meshlets outside the frustum, or whose faces would all be culled, are skipped before any of their vertices are projected
+bool Camera::meshletVisible(const Mesh &mesh, const MeshletList &meshlets, const Meshlet &meshlet, const MeshletBounds &bounds) {
+    if (!sphereInFrustum(bounds.center, bounds.radius))
+        return false;
+    if (!renderScene->backFaceCulling || !coneCulled(bounds))
+        return true;
+    // Materials can change without the mesh's version changing, so this is checked every time
+    for (uint32_t i = meshlet.faceBegin; i < meshlet.faceEnd; i++) {
+        const Material *material = mesh.faces[meshlets.faces[i]].material.get();
+        if (material->flags.transparent || material->flags.doubleSided)
+            return true;
+    }
+    return false;
+}
 
-                for (size_t j = 0; j < mesh->faces.size(); j++) {
-                    Face &face = mesh->faces[j];
-                    Projection v1s = projectedVertices[face.v1],
-                               v2s = projectedVertices[face.v2],
-                               v3s = projectedVertices[face.v3];
-                    Vec3 normalS = (v3s.screenPos - v1s.screenPos).cross(v2s.screenPos - v1s.screenPos).normalized();
-
-                    Triangle tri = {
-                        .s1 = v1s,
-                        .s2 = v2s,
-                        .s3 = v3s,
-                        .uv1 = mesh->vertices[face.v1].uv,
-                        .uv2 = mesh->vertices[face.v2].uv,
-                        .uv3 = mesh->vertices[face.v3].uv,
-                        .mat = face.material,
-                        .face = &face,
-                        .mesh = mesh,
-                        .cull = normalS.z < 0
-                    };
-                    if (face.material->flags.transparent) {
-                        transparents.push_back(TransparentTriangle{
-                            (v1s.screenPos.z + v2s.screenPos.z + v3s.screenPos.z) / 3, tri });
-                    } else {
-                        triangles.push_back(tri);
-                    }
-                }
+// Fills the triangle lists of the face chunks, and transparents. The faces of visible meshlets, and the vertices they
+// use, are split into chunks and processed by the worker threads. Each face chunk has its own triangle lists, which
+// are kept where they are and binned in chunk order, so the result doesn't depend on thread timing.
+void Camera::buildTriangles() {
+    Scene *scene = renderScene;
+    vertexChunks.clear();
+    faceChunkCount = 0;
+    size_t vertexCount = 0;
+    scene->bvh.cull(this, visibleMeshes);
+    for (MeshComponent *meshComp : visibleMeshes) {
+        size_t level = meshComp->lodLevel(this);
+        Mesh *mesh = meshComp->lodMesh(level);
+        const WorldVertices *worldVertices = &meshComp->worldVertices(level);
+        const MeshletList &meshlets = mesh->meshlets();
+
+        // Consecutive visible meshlets share a face chunk
+        AssemblyChunk *chunk = nullptr;
+        usedVertices.assign(mesh->vertices.size(), false);
+        for (size_t j = 0; j < meshlets.meshlets.size(); j++) {
+            const Meshlet &meshlet = meshlets.meshlets[j];
+            if (!meshletVisible(*mesh, meshlets, meshlet, worldVertices->meshlets[j]))
+                continue;
+            for (uint32_t k = meshlet.vertexBegin; k < meshlet.vertexEnd; k++)
+                usedVertices[meshlets.vertices[k]] = true;
+            if (chunk && chunk->end == meshlet.faceBegin && meshlet.faceEnd - chunk->begin <= faceChunkSize) {
+                chunk->end = meshlet.faceEnd;
+                continue;
             }
+            if (faceChunkCount == faceChunks.size())
+                faceChunks.emplace_back();
+            if (faceChunkCount >> (32 - triangleIndexBits)) // Out of triangle ids, hundreds of millions of faces
+                throw std::runtime_error("Too many faces to render");
+            chunk = &faceChunks[faceChunkCount++];
+            chunk->mesh = mesh;
+            chunk->worldVertices = worldVertices;
+            chunk->faceIndices = meshlets.faces.data();
+            chunk->begin = meshlet.faceBegin;
+            chunk->end = meshlet.faceEnd;
+            chunk->vertexOffset = vertexCount;
+        }
+
+        // Only the vertices of visible meshlets are projected. Short gaps between them are projected anyway, so there
+        // are fewer chunks.
+        size_t vertexTotal = mesh->vertices.size();
+        for (size_t j = 0; j < vertexTotal;) {
+            if (!usedVertices[j]) {
+                j++;
+                continue;
+            }
+            size_t begin = j, end = j + 1;
+            for (j++; j < vertexTotal && j - begin < vertexChunkSize && j - end < vertexChunkGap; j++)
+                if (usedVertices[j])
+                    end = j + 1;
+            vertexChunks.push_back(AssemblyChunk{
+                .mesh = mesh,
+                .worldVertices = worldVertices,
+                .begin = begin,
+                .end = end,
+                .vertexOffset = vertexCount,
+            });
+            j = end;
+        }
+        vertexCount += mesh->vertices.size();
+    }
+
+    projectedVertices.resize(vertexCount);
+    startThreads(this, ThreadJob::Vertices);
+    startThreads(this, ThreadJob::Primitives);
+
+    // Only the transparent ones are gathered, to be sorted
+    for (uint32_t c = 0; c < faceChunkCount; c++) {
+        std::vector<Triangle> &chunkTransparents = faceChunks[c].transparents;
+        for (uint32_t i = 0; i < chunkTransparents.size(); i++) {
+            Triangle &tri = chunkTransparents[i];
+            float z = (tri.s1.screenPos.z + tri.s2.screenPos.z + tri.s3.screenPos.z) / 3;
+            transparents.push_back(TransparentTriangle{z, c << triangleIndexBits | i});
         }
-        for (auto &&child : obj->children)
-            handleObject(child);
+    }
+}
+
+void vertexPass(Camera *camera, size_t c) {
+    thread_local Vec3Stream clip;
+    AssemblyChunk &chunk = camera->vertexChunks[c];
+    const WorldVertices &worldVertices = *chunk.worldVertices;
+    transformProjective(worldVertices.positions, camera->projectionMatrix, clip, chunk.begin, chunk.end);
+    for (size_t j = chunk.begin; j < chunk.end; j++) {
+        Projection &p = camera->projectedVertices[chunk.vertexOffset + j];
+        p = camera->projectionFromClip(worldVertices.positions[j], clip[j - chunk.begin]);
+        p.normal = worldVertices.normals[j];
+    }
+}
+
+void primitivePass(Camera *camera, size_t c) {
+    thread_local std::vector<Triangle> clipped;
+    AssemblyChunk &chunk = camera->faceChunks[c];
+    chunk.triangles.clear();
+    chunk.transparents.clear();
+    Mesh *mesh = chunk.mesh;
+    const Projection *projectedVertices = &camera->projectedVertices[chunk.vertexOffset];
+    for (size_t j = chunk.begin; j < chunk.end; j++) {
+        Face &face = mesh->faces[chunk.faceIndices[j]];
+        const Projection &v1s = projectedVertices[face.v1],
+                         &v2s = projectedVertices[face.v2],
+                         &v3s = projectedVertices[face.v3];
+        Vec3 normalS = (v3s.screenPos - v1s.screenPos).cross(v2s.screenPos - v1s.screenPos).normalized();
+
+        Triangle tri = {
+            .s1 = v1s,
+            .s2 = v2s,
+            .s3 = v3s,
+            .uv1 = mesh->vertices[face.v1].uv,
+            .uv2 = mesh->vertices[face.v2].uv,
+            .uv3 = mesh->vertices[face.v3].uv,
+            .mat = face.material.get(),
+            .face = &face,
+            .mesh = chunk.mesh,
+            .cull = normalS.z < 0
+        };
+        auto &&addTriangle = [&](Triangle &tri) {
+            if (face.material->flags.transparent)
+                chunk.transparents.push_back(tri);
+            else
+                chunk.triangles.push_back(tri);
+        };
+        clipped.clear();
+        // The pieces are separate triangles from here on, so each is binned and rasterized over its own bounds
+        if (clipTriangle(camera, tri, clipped)) {
+            for (auto &&piece : clipped)
+                addTriangle(piece);
+        }
+        else
+            addTriangle(tri);
+    }
+}
+
+void Camera::drawTriangles(TriangleList list, DrawMode mode) {
+    binTriangles(list);
+    drawBinned(mode);
+}
+
+// Bins straight from the face chunks' lists, only the ids and bounds of the triangles on screen are written
+void Camera::binTriangles(TriangleList list) {
+    for (auto &&bin : frame->tileBins)
+        bin.clear();
+    binnedList = list;
+    binnedIds.clear();
+    binnedBounds.clear();
+
+    auto &&bin = [&](uint32_t id) {
+        ScreenBounds bounds;
+        Triangle &tri = list == TriangleList::Opaque ? opaqueTriangle(id) : transparentTriangle(id);
+        if (!triangleScreenBounds(this, tri, bounds.min, bounds.max))
+            return;
+        uint32_t position = binnedIds.size();
+        binnedIds.push_back(id);
+        binnedBounds.push_back(bounds);
+        for (int ty = bounds.min.y / RenderTarget::tileSize; ty <= (bounds.max.y - 1) / (int)RenderTarget::tileSize; ty++)
+            for (int tx = bounds.min.x / RenderTarget::tileSize; tx <= (bounds.max.x - 1) / (int)RenderTarget::tileSize; tx++)
+                frame->tileBins[tx + ty * frame->tileCount.x].push_back(position);
     };
+    if (list == TriangleList::Opaque) {
+        for (uint32_t c = 0; c < faceChunkCount; c++)
+            for (uint32_t i = 0; i < faceChunks[c].triangles.size(); i++)
+                bin(c << triangleIndexBits | i);
+    }
+    else
+        for (const TransparentTriangle &tri : transparents)
+            bin(tri.triangle);
+}
+
+void Camera::drawBinned(DrawMode mode) {
+    binnedMode = mode;
+    startThreads(this, ThreadJob::Geometry);
+}
 
-    for (auto &&obj : scene->objects)
-        handleObject(obj);
+// Only one thread draws a tile, and it draws the tile's triangles in submission order,
+// so no locking is needed and the output doesn't depend on thread timing.
+void geometryPass(Camera *camera, size_t tile) {
+    RenderTarget *frame = camera->frame;
+    Vector2i tileMin, tileMax;
+    frame->tileBounds(tile, tileMin, tileMax);
+    // Wireframe lines round their ends to pixels, which can be just past the triangle's bounds, so they get the whole tile
+    bool wireFrame = camera->renderScene->wireFrame;
+    for (uint32_t i : frame->tileBins[tile]) {
+        if (wireFrame) {
+            drawTriangle(camera, camera->binnedTriangle(i), camera->binnedMode, tileMin, tileMax, camera->binnedIds[i]);
+            continue;
+        }
+        // Only the part of the triangle's bounds inside this tile, not the whole tile
+        const ScreenBounds &bounds = camera->binnedBounds[i];
+        Vector2i min{std::max(bounds.min.x, tileMin.x), std::max(bounds.min.y, tileMin.y)};
+        Vector2i max{std::min(bounds.max.x, tileMax.x), std::min(bounds.max.y, tileMax.y)};
+        drawTriangle(camera, camera->binnedTriangle(i), camera->binnedMode, min, max, camera->binnedIds[i]);
+    }
 }
 
 void skyBoxPixel(Camera *camera, RenderTarget *frame, uint i, uint x, uint y) {
-    shared_ptr<Scene> scene = camera->obj->scene.lock();
+    Scene *scene = camera->renderScene;
     Vec3 lookVector = camera->screenSpaceToCameraSpace(x, y, 1) * camera->obj->transformRotation;
     lookVector = lookVector.normalized();
     frame->framebuffer[i] = scene->skyBox->sample(lookVector);
@@ -169,85 +354,140 @@ void Camera::drawSkyBox() {
         return;
     }
 
-    for (uint y = 0; y < frame->size.y; y++) {
-        for (uint x = 0; x < frame->size.x; x++) {
-            size_t i = y * frame->size.x + x;
-            skyBoxPixel(this, frame, i, x, y);
-        }
-    }
+    startThreads(this, ThreadJob::SkyBox);
 }
 
+void skyBoxPass(Camera *camera, size_t tile) {
+    RenderTarget *frame = camera->frame;
+    Vector2i min, max;
+    frame->tileBounds(tile, min, max);
+    for (int y = min.y; y < max.y; y++)
+        for (int x = min.x; x < max.x; x++)
+            skyBoxPixel(camera, frame, y * frame->size.x + x, x, y);
+}
 
-void deferredPass(uint n, uint i0, Camera *camera) {
-    shared_ptr<Scene> scene = camera->obj->scene.lock();
-    if(!scene) return;
 
+void deferredPass(Camera *camera, size_t tile) {
+    Scene *scene = camera->renderScene;
     RenderTarget *frame = camera->frame;
 
     SolidEnvironmentMap *solidSkyBox = checkSolidSkyBox(scene->skyBox);
 
-    for (size_t i = i0; i < frame->size.x * frame->size.y; i += n) {
-        Fragment &f = frame->gBuffer[i];
-        float z = f.z; // keep track of last shaded Z for fog
-        if (z == INFINITY) { // No opaque fragment here, must be skyBox
-            if (solidSkyBox) {
-                frame->framebuffer[i] = solidSkyBox->value; // No need to compute UV
+    // Neighboring pixels of the visibility buffer usually share a triangle setup
+    std::optional<TriangleSetup> setup;
+    thread_local std::vector<Fragment*> layers;
+    Vector2i min, max;
+    frame->tileBounds(tile, min, max);
+    for (size_t y = min.y; y < (size_t)max.y; y++) {
+        for (size_t x = min.x; x < (size_t)max.x; x++) {
+            size_t i = x + y * frame->size.x;
+            Fragment unpacked{.z = INFINITY};
+            if (frame->gBufferLayout == GBufferLayout::Packed && frame->packedGBuffer.face[i]) {
+                unpacked = frame->packedGBuffer.load(camera, x, y, frame->zBuffer[i]);
+            }
+            else if (frame->gBufferLayout == GBufferLayout::Visibility && frame->visibility[i] != UINT32_MAX) {
+                Triangle &tri = camera->opaqueTriangle(frame->visibility[i]);
+                if (!setup || setup->tri != &tri)
+                    setup.emplace(camera, tri);
+                unpacked = setup->fragment({(int)x, (int)y}, frame->zBuffer[i]);
+            }
+            Fragment &f = frame->gBufferLayout == GBufferLayout::Fragments ? frame->gBuffer[i] : unpacked;
+            float z = f.z; // keep track of last shaded Z for fog
+            if (z == INFINITY) { // No opaque fragment here, must be skyBox
+                if (solidSkyBox) {
+                    frame->framebuffer[i] = solidSkyBox->value; // No need to compute UV
+                } else {
+                    skyBoxPixel(camera, frame, i, x, y);
+                }
+            } else { // Opaque fragment here
+                // Only whole fragments keep the base color sampled for alpha cutout in the geometry pass
+                if (frame->deferred && (frame->gBufferLayout != GBufferLayout::Fragments || !f.face->material->flags.alphaCutout))
+                    f.baseColor = f.face->material->getBaseColor(f.uv, f.dUVdx, f.dUVdy);
+                frame->framebuffer[i] = f.face->material->shade(f, frame->framebuffer[i], *scene);
+            }
+
+            // Transparent fragments, back to front. Pixels have a few, so each one is inserted after the deeper ones
+            // as it's gathered. Lists are newest first, and equal depths keep that order.
+            layers.clear();
+            auto &&insert = [&](Fragment *layer) {
+                layers.push_back(layer);
+                size_t j = layers.size() - 1;
+                for (; j > 0 && layers[j - 1]->z < layer->z; j--)
+                    layers[j] = layers[j - 1];
+                layers[j] = layer;
+            };
+            if (frame->transparencyLayers) {
+                for (uint32_t j = 0; j < frame->transparencyHeads[i]; j++)
+                    insert(&frame->transparencyLayerFragments[i * frame->transparencyLayers + j]);
             } else {
-                int x = i % frame->size.x, y= i / frame->size.x;
-                skyBoxPixel(camera, frame, i, x, y);
+                for (uint32_t next = frame->transparencyHeads[i]; next != UINT32_MAX; next = frame->transparencyFragments[next].next)
+                    insert(&frame->transparencyFragments[next].f);
             }
-        } else { // Opaque fragment here
-            if (frame->deferred && !f.face->material->flags.alphaCutout)
-                f.baseColor = f.face->material->getBaseColor(f.uv, f.dUVdx, f.dUVdy);
-            frame->framebuffer[i] = f.face->material->shade(f, frame->framebuffer[i], *scene);
-        }
+            for (Fragment *layer : layers) {
+                Fragment &f = *layer;
 
-        // Transparent fragments
-        for (uint32_t next = frame->transparencyHeads[i]; next != (uint32_t)-1;) {
-            FragmentNode &node = frame->transparencyFragments[next];
-            Fragment &f = node.f;
+                fogTransparency(f, frame->framebuffer[i], z);
 
-            fogTransparency(f, frame->framebuffer[i], z);
+                frame->framebuffer[i] = f.face->material->shade(f, frame->framebuffer[i], *scene);
 
-            frame->framebuffer[i] = f.face->material->shade(f, frame->framebuffer[i], *scene);
+                z = f.z;
+            }
+            frame->zBuffer[i] = z; // z buffer isn't accurate after geometry pass because triangle order is reverse, so here we fix it
+        }
+    }
+}
 
-            z = f.z;
-            next = node.next;
+// Weighted blended order independent transparency (McGuire and Bavoil 2013): the average color of the transparent
+// fragments, weighted by coverage and closeness, is blended over the background by their combined transmittance
+void transparencyResolvePass(Camera *camera, size_t tile) {
+    RenderTarget *frame = camera->frame;
+    Vector2i min, max;
+    frame->tileBounds(tile, min, max);
+    for (int y = min.y; y < max.y; y++) {
+        for (int x = min.x; x < max.x; x++) {
+            size_t i = x + y * frame->size.x;
+            Color accumulated = frame->transparencyAccumulation[i];
+            Color revealage = frame->transparencyRevealage[i];
+            if (accumulated.a == 0)
+                continue;
+            Color average = accumulated / std::max(accumulated.a, 1e-5f);
+            float coverage = 1 - (revealage.r + revealage.g + revealage.b) / 3;
+            Color result = frame->framebuffer[i] * revealage + average * coverage;
+            result.a = 1;
+            frame->framebuffer[i] = result;
         }
-        frame->zBuffer[i] = z; // z buffer isn't accurate after geometry pass because triangle order is reverse, so here we fix it
     }
 }
 
-void fogPass(uint n, uint i0, Camera *camera) {
-    shared_ptr<Scene> scene = camera->obj->scene.lock();
-    if(!scene) return;
+void fogPass(Camera *camera, size_t tile) {
+    Scene *scene = camera->renderScene;
     if(!scene->volume)
         return;
 
     RenderTarget *frame = camera->frame;
-    for (size_t i = i0; i < frame->size.x * frame->size.y; i += n) {
-        if(frame->zBuffer[i] == INFINITY && !(scene->volume && scene->volume->godRays)) // Sky-box pixels don't get fog unless its godRays
-            continue;
-        int x = i % frame->size.x, y= i / frame->size.x;
-        float z = camera->frame->zBuffer[i];
-
-        if(z == INFINITY) {
-            if(scene->volume && scene->volume->godRays)
+    Vector2i min, max;
+    frame->tileBounds(tile, min, max);
+    for (int y = min.y; y < max.y; y++) {
+        for (int x = min.x; x < max.x; x++) {
+            size_t i = x + y * frame->size.x;
+            float z = frame->zBuffer[i];
+            if(z == INFINITY) {
+                if(!scene->volume->godRays) // Sky-box pixels don't get fog unless its godRays
+                    continue;
                 z = camera->farClip;
-            else
-                return;
-        }
+            }
 
-        Vec3 cameraSpace = camera->screenSpaceToCameraSpace(x, y, z);
-
-        camera->frame->framebuffer[i] = sampleFog(
-            cameraSpace * camera->obj->transform, 
-            camera->orthographic ? 
-                camera->obj->globalPosition + Vec3{cameraSpace.x, cameraSpace.y, 0} * camera->obj->transformRotation :
-                camera->obj->globalPosition,
-            camera->frame->framebuffer[i],
-            *scene,
-            scene->volume
-        );
+            Vec3 cameraSpace = camera->screenSpaceToCameraSpace(x, y, z);
+
+            frame->framebuffer[i] = sampleFog(
+                cameraSpace * camera->obj->transform, 
+                camera->orthographic ? 
+                    camera->obj->globalPosition + Vec3{cameraSpace.x, cameraSpace.y, 0} * camera->obj->transformRotation :
+                    camera->obj->globalPosition,
+                frame->framebuffer[i],
+                *scene,
+                scene->volume
+            );
+        }
     }
 }
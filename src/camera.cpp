@@ -1,6 +1,7 @@
 #include "camera.h"
 #include "data.h"
 #include "triangle.h"
+#include "multithreading.h"
 #include <imgui.h>
 #include <SFML/System/Clock.hpp>
 
@@ -9,28 +10,37 @@ void Camera::update() {
 }
 
 Projection Camera::perspectiveProject(Vec3 a) {
-    Vec3 b = a - obj->globalPosition;
-    float vM[4] = {b.x, b.y, b.z, 1};
-    matMul(vM, projectionMatrix.data(), vM, 1, 4, 4);
-    return Projection{
-        .worldPos = a,
-        .screenPos = orthographic ? -Vec3{vM[0], vM[1], vM[3]} : Vec3{vM[0] / vM[3], vM[1] / vM[3], -vM[3]},
-    };
+    return projectionFromClip(a, transformProjective(a, projectionMatrix));
 }
 
 sf::Image Camera::getRenderedFrame(int renderMode) { 
     sf::Image img(frame->size);
-    for (unsigned int y = 0; y < frame->size.y; y++)
-        for (unsigned int x = 0; x < frame->size.x; x++)
-            if (renderMode == 0) { // Frame buffer
-                Color pixel = frame->framebuffer[y * frame->size.x + x];
-                img.setPixel({x, y}, pixel.reinhardtTonemap(whitePoint==0 ? maximumColor : whitePoint));
-            }
-            else if (renderMode == 1) { // Z buffer
-                // Z buffer range is really display-to-end-user unfriendly
-                float z = frame->zBuffer[y * frame->size.x + x] * 20.0f;
-                img.setPixel({x, y}, sf::Color(z, z, z));
-            }
+    // Tiles write distinct pixels of the image, so they can be tonemapped in parallel
+    parallelFor(frame->tileCount.x * frame->tileCount.y, [&](size_t tile) {
+        sf::Vector2i min, max;
+        frame->tileBounds(tile, min, max);
+        for (unsigned int y = min.y; y < (unsigned int)max.y; y++)
+            for (unsigned int x = min.x; x < (unsigned int)max.x; x++)
+                if (renderMode == 0) { // Frame buffer
+                    Color pixel = frame->framebuffer[y * frame->size.x + x];
+                    img.setPixel({x, y}, pixel.reinhardtTonemap(whitePoint==0 ? maximumColor : whitePoint));
+                }
+                else if (renderMode == 1) { // Z buffer
+                    // Z buffer range is really display-to-end-user unfriendly
+                    float z = frame->zBuffer[y * frame->size.x + x] * 20.0f;
+                    img.setPixel({x, y}, sf::Color(z, z, z));
+                }
+    });
+    return img;
+}
+
+sf::Image tonemap(const std::vector<Color> &framebuffer, Vector2u size, float whitePoint) {
+    sf::Image img(size);
+    for (unsigned int y = 0; y < size.y; y++)
+        for (unsigned int x = 0; x < size.x; x++) {
+            Color pixel = framebuffer[y * size.x + x];
+            img.setPixel({x, y}, pixel.reinhardtTonemap(whitePoint));
+        }
     return img;
 }
 
@@ -40,8 +50,8 @@ Vec3 Camera::screenSpaceToCameraSpace(int x, int y) {
     return screenSpaceToCameraSpace(x, y, z);
 }
 
-Vec3 Camera::screenSpaceToCameraSpace(int x, int y, float z) { 
-    Vector2f worldPos{x / (float)frame->size.x, y / (float)frame->size.y};
+Vec3 Camera::screenSpaceToCameraSpace(float x, float y, float z) { 
+    Vector2f worldPos{x / frame->size.x, y / frame->size.y};
     worldPos = (Vector2f{0.5, 0.5} - worldPos) * 2.0f * (orthographic ? 1 : z) * tanHalfFov;
     return Vec3{worldPos.x, worldPos.y, z};
 }
@@ -50,19 +60,87 @@ Vec3 Camera::screenSpaceToWorldSpace(int x, int y) {
     return screenSpaceToCameraSpace(x, y) * obj->transform;
 }
 
-Vec3 Camera::screenSpaceToWorldSpace(int x, int y, float z) {
+Vec3 Camera::screenSpaceToWorldSpace(float x, float y, float z) {
     return screenSpaceToCameraSpace(x, y, z) * obj->transform;
 }
 
+float Camera::projectedSize(Vec3 center, float radius) {
+    float distance = orthographic ? 1 : std::max((center - obj->globalPosition).length(), nearClip);
+    return radius / (distance * tanHalfFov);
+}
+
+Face *Camera::pick(int x, int y) {
+    shared_ptr<Scene> scene = obj->scene.lock();
+    if(!scene) return nullptr;
+    scene->bvh.update(scene->renderList()); // Objects may have been added or removed since the last render
+    Vec3 near = screenSpaceToWorldSpace(x + 0.5f, y + 0.5f, nearClip);
+    Vec3 far = screenSpaceToWorldSpace(x + 0.5f, y + 0.5f, farClip);
+    return scene->bvh.raycast(near, far - near, 1, scene->backFaceCulling);
+}
+
 void Camera::makePerspectiveProjectionMatrix() {
     float S = 1 / (tanHalfFov = orthographic ? fov : tan(fov * M_PI / 360));
     float f = -farClip / (farClip - nearClip);
-    matMul(transposeMatrix(obj->transformRotation).data(), (float[]){
+    Vec3 p = obj->globalPosition;
+    TransformMatrix &m = projectionMatrix = TransformMatrix{
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        -p.x, -p.y, -p.z, 1,
+    } * transposeMatrix(obj->transformRotation) * TransformMatrix{
         S, 0, 0, 0,
         0, S, 0, 0,
         0, 0, f,-1,
         0, 0,-f*nearClip,0
-    }, projectionMatrix.data(), 4,4,4);
+    };
+
+    // Clip space x, y and w are linear in world space, so are the conditions triangleScreenBounds checks on them
+    FrustumPlane x{{m[0], m[4], m[8]}, m[12]}, y{{m[1], m[5], m[9]}, m[13]}, depth{-Vec3{m[3], m[7], m[11]}, -m[15]};
+    auto &&add = [](FrustumPlane a, FrustumPlane b, float sign) { return FrustumPlane{a.normal + b.normal * sign, a.distance + b.distance * sign}; };
+    // Distance from the screen edges is in multiples of depth for perspective projection, and constant for orthographic
+    FrustumPlane edge = orthographic ? FrustumPlane{{0, 0, 0}, 1} : depth;
+    frustumPlanes = {
+        FrustumPlane{depth.normal, depth.distance - nearClip},
+        FrustumPlane{-depth.normal, farClip - depth.distance},
+        add(edge, x, 1), add(edge, x, -1),
+        add(edge, y, 1), add(edge, y, -1),
+    };
+    for (auto &&plane : frustumPlanes) {
+        float length = plane.normal.length();
+        if (length > 0) {
+            plane.normal /= length;
+            plane.distance /= length;
+        }
+    }
+}
+
+bool Camera::sphereInFrustum(Vec3 center, float radius) {
+    for (auto &&plane : frustumPlanes)
+        if (plane.normal.dot(center) + plane.distance < -radius)
+            return false;
+    return true;
+}
+
+bool Camera::boxInFrustum(Vec3 min, Vec3 max) {
+    for (auto &&plane : frustumPlanes) {
+        // The corner furthest along the normal
+        Vec3 corner{
+            plane.normal.x >= 0 ? max.x : min.x,
+            plane.normal.y >= 0 ? max.y : min.y,
+            plane.normal.z >= 0 ? max.z : min.z,
+        };
+        if (plane.normal.dot(corner) + plane.distance < 0)
+            return false;
+    }
+    return true;
+}
+
+bool Camera::coneCulled(const MeshletBounds &bounds) {
+    Vec3 axis = shadowMap ? -bounds.coneAxis : bounds.coneAxis; // Shadow maps have front face culling
+    if (orthographic) // Every face is seen from the same direction
+        return frustumPlanes[0].normal.dot(axis) >= bounds.coneCutoff;
+    Vec3 toCenter = bounds.center - obj->globalPosition;
+    return toCenter.dot(axis) >= bounds.coneCutoff * toCenter.length() + bounds.radius;
 }
 
 void Camera::GUI() {
@@ -3,8 +3,70 @@
 
 #include "object.h"
 #include <memory>
+#include <span>
 
 struct RenderTarget;
+struct Scene;
+class Light;
+
+// What rasterizing a triangle does with the fragments that pass the depth test
+enum class DrawMode {
+    Forward,    // Shade into the framebuffer
+    Deferred,   // Write to the G-buffer (or the transparent fragment lists), shade later in deferredPass
+    DepthOnly,  // Only write the z-buffer
+    DepthEqual, // Shade only fragments whose depth equals the z-buffer, after a DepthOnly pre-pass
+    Visibility, // Write the z-buffer and the triangle's index to the visibility buffer, fragments are rebuilt in deferredPass
+    WeightedBlended, // Shade transparent fragments and accumulate them for transparencyResolvePass, in any order
+};
+
+// A range of a mesh's vertices or faces, processed by one thread in vertexPass or primitivePass
+struct AssemblyChunk {
+    Mesh *mesh;
+    const WorldVertices *worldVertices;
+    const uint32_t *faceIndices = nullptr; // For face chunks, begin and end are positions in this list of indices of mesh->faces
+    size_t begin, end;
+    size_t vertexOffset; // Where the mesh's vertices are in Camera::projectedVertices
+    // Output of primitivePass, kept between renders so their memory is reused. The triangles of a render stay here
+    // until the next one, the rest of the render refers to them by id, see Camera::opaqueTriangle.
+    std::vector<Triangle> triangles, transparents;
+};
+
+// Which triangles of a render binTriangles bins
+enum class TriangleList {
+    Opaque,      // In face chunk order
+    Transparent, // In the order of Camera::transparents
+};
+
+// Pixels from min to max, exclusive
+struct ScreenBounds {
+    sf::Vector2i min, max;
+};
+
+// Points where normal.dot(p) + distance >= 0 are on the inside
+struct FrustumPlane {
+    Vec3 normal;
+    float distance;
+};
+
+// Lights that can reach each cluster of the view, a screen tile (RenderTarget::tileSize) and a slice of depth.
+// Rebuilt by every render that shades, so shading only goes through the lights near a fragment.
+struct LightClusters {
+    static constexpr uint depthSlices = 16; // Thicker the further they are, between nearClip and farClip
+    sf::Vector2u tileCount;
+    float nearClip, sliceScale; // Slice of a depth is log(depth / nearClip) * sliceScale
+    std::vector<Light *> unbounded; // Lights that reach everything, they aren't in the clusters' lists
+    std::vector<Light *> lights;    // List of each cluster, one after the other, from offsets[cluster] to offsets[cluster + 1]
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> next; // Where the next light of each cluster goes while building, kept so its memory is reused
+    uint slice(float depth) const {
+        return depth <= nearClip ? 0 : std::min((uint)(std::log(depth / nearClip) * sliceScale), depthSlices - 1);
+    }
+};
+
+// Clusters a light may reach, inclusive
+struct ClusterRange {
+    uint minX, maxX, minY, maxY, minSlice, maxSlice;
+};
 
 class Camera : public Component, public std::enable_shared_from_this<Camera> {
   public:
@@ -14,26 +76,115 @@ class Camera : public Component, public std::enable_shared_from_this<Camera> {
     bool shadowMap = false;
     bool orthographic = false;
     RenderTarget *frame;
+    Scene *renderScene = nullptr; // Scene of the current render, so per-triangle code doesn't have to lock obj->scene
+    // Triangles currently being rasterized by geometryPass, set by binTriangles. The tile bins hold positions in these.
+    TriangleList binnedList = TriangleList::Opaque;
+    std::vector<uint32_t> binnedIds;
+    std::vector<ScreenBounds> binnedBounds;
+    DrawMode binnedMode = DrawMode::Forward;
+    // The triangles of the current render are left in the face chunks that made them, and referred to by an id:
+    // the chunk's index above triangleIndexBits, the triangle's index in the chunk's list below them.
+    // They're kept until the next render, the visibility buffer holds ids of opaque ones.
+    static constexpr uint32_t triangleIndexBits = 14;
+    Triangle &opaqueTriangle(uint32_t id) {
+        return faceChunks[id >> triangleIndexBits].triangles[id & ((1u << triangleIndexBits) - 1)];
+    }
+    Triangle &transparentTriangle(uint32_t id) {
+        return faceChunks[id >> triangleIndexBits].transparents[id & ((1u << triangleIndexBits) - 1)];
+    }
+    Triangle &binnedTriangle(uint32_t position) {
+        uint32_t id = binnedIds[position];
+        return binnedList == TriangleList::Opaque ? opaqueTriangle(id) : transparentTriangle(id);
+    }
+    // Ids of the transparent triangles and their average depth, sorted back to front when the order matters
+    std::vector<TransparentTriangle> transparents;
+    // Vertex and primitive assembly work of buildTriangles
+    std::vector<MeshComponent *> visibleMeshes;
+    std::vector<AssemblyChunk> vertexChunks, faceChunks;
+    size_t faceChunkCount = 0; // faceChunks only grows, the rest are unused
+    std::vector<bool> usedVertices; // Vertices of the visible meshlets of a mesh
+    std::vector<Projection> projectedVertices;
+    static constexpr size_t vertexChunkSize = 4096, faceChunkSize = 2048, vertexChunkGap = 64;
+    // Clipping a face can make up to 6 triangles, they all need an id
+    static_assert(faceChunkSize * 6 <= 1u << triangleIndexBits);
+    TransformMatrix projectionMatrix; // World space to clip space, including the camera's position
+    std::array<FrustumPlane, 6> frustumPlanes; // In world space, updated with projectionMatrix
+    LightClusters lightClusters;
     void render();
     std::string name() { return "Camera"; }
     void GUI();
     void update();
     Projection perspectiveProject(Vec3 a);
+    // Finishes the projection of a point whose x, y and w after projectionMatrix are known
+    Projection projectionFromClip(Vec3 worldPos, Vec3 clipXYW) {
+        Vec3 c = clipXYW;
+        return Projection{
+            .worldPos = worldPos,
+            .screenPos = orthographic ? -c : Vec3{c.x / c.z, c.y / c.z, -c.z},
+        };
+    }
+    // Tonemapped frame buffer with renderMode 0, z buffer with 1
     sf::Image getRenderedFrame(int renderMode);
     Vec3 screenSpaceToCameraSpace(int x, int y);
-    Vec3 screenSpaceToCameraSpace(int x, int y, float z);
+    Vec3 screenSpaceToCameraSpace(float x, float y, float z);
     Vec3 screenSpaceToWorldSpace(int x, int y);
-    Vec3 screenSpaceToWorldSpace(int x, int y, float z);
+    Vec3 screenSpaceToWorldSpace(float x, float y, float z);
+    // Roughly the fraction of the view's height a sphere covers
+    float projectedSize(Vec3 center, float radius);
+    // Face visible at the pixel, found by casting a ray, so it works with any kind of render target
+    Face *pick(int x, int y);
+    // Conservative, may return true for volumes just outside the corners of the frustum. Uses the last render's frustum.
+    bool sphereInFrustum(Vec3 center, float radius);
+    bool boxInFrustum(Vec3 min, Vec3 max);
+    bool boundsInFrustum(const Bounds &bounds) {
+        return bounds.radius >= 0 && sphereInFrustum(bounds.center, bounds.radius) && boxInFrustum(bounds.min, bounds.max);
+    }
+    // Lights with a range that may reach a point at the pixel and depth, the others are in lightClusters.unbounded
+    std::span<Light *const> clusterLights(sf::Vector2i pixel, float z) const;
+    // Same for a world position, which has to be in view, like the samples along a pixel's ray through fog
+    std::span<Light *const> clusterLights(Vec3 worldPos);
+    // Calls fn with every light that may reach a point at the pixel and depth, or at a world position in view
+    template<typename F>
+    void forEachLight(sf::Vector2i pixel, float z, F &&fn) {
+        for (Light *light : lightClusters.unbounded)
+            fn(light);
+        for (Light *light : clusterLights(pixel, z))
+            fn(light);
+    }
+    template<typename F>
+    void forEachLight(Vec3 worldPos, F &&fn) {
+        for (Light *light : lightClusters.unbounded)
+            fn(light);
+        for (Light *light : clusterLights(worldPos))
+            fn(light);
+    }
+    // Whether every face inside the bounds' normal cone would be culled, facing away from the camera, or towards it for shadow maps
+    bool coneCulled(const MeshletBounds &bounds);
 
   private:
     void makePerspectiveProjectionMatrix();
+    void buildLightClusters(Scene &scene);
+    // False if the light can't reach anything in view
+    bool lightClusterRange(Light *light, ClusterRange &range);
     void drawSkyBox();
-    void buildTriangles(std::vector<TransparentTriangle> &transparents, std::vector<Triangle> &triangles);
-    TransformMatrix projectionMatrix;
+    void buildTriangles();
+    bool meshletVisible(const Mesh &mesh, const MeshletList &meshlets, const Meshlet &meshlet, const MeshletBounds &bounds);
+    void drawTriangles(TriangleList list, DrawMode mode);
+    void binTriangles(TriangleList list);
+    void drawBinned(DrawMode mode);
     float tanHalfFov;
 };
 
-void deferredPass(uint n, uint i0, Camera *camera);
-void fogPass(uint n, uint i0, Camera *camera);
+// Reinhardt tonemapping of a frame buffer, on the calling thread only
+sf::Image tonemap(const std::vector<Color> &framebuffer, Vector2u size, float whitePoint);
+
+// Tasks of the render passes run by startThreads, for one chunk of Camera::vertexChunks or faceChunks, or one screen tile
+void vertexPass(Camera *camera, size_t chunk);
+void primitivePass(Camera *camera, size_t chunk);
+void geometryPass(Camera *camera, size_t tile);
+void deferredPass(Camera *camera, size_t tile);
+void transparencyResolvePass(Camera *camera, size_t tile);
+void fogPass(Camera *camera, size_t tile);
+void skyBoxPass(Camera *camera, size_t tile);
 
 #endif /* __CAMERA_H__ */
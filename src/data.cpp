@@ -2,26 +2,154 @@
 #include "color.h"
 #include "object.h"
 #include "gui.h"
+#include <algorithm>
 #include <vector>
 
 std::vector<std::weak_ptr<Scene>> scenes;
 FrameTimings timing;
 std::shared_ptr<Window> currentWindow;
+thread_local Camera *shadingCamera = nullptr;
 bool initComplete = false;
 
+static void gatherMeshes(const std::vector<shared_ptr<Object>> &objects, std::vector<MeshComponent *> &out) {
+    for (auto &&obj : objects) {
+        for (auto &&comp : obj->components)
+            if (MeshComponent *meshComp = dynamic_cast<MeshComponent *>(comp.get()))
+                out.push_back(meshComp);
+        gatherMeshes(obj->children, out);
+    }
+}
+
+const std::vector<MeshComponent *> &Scene::renderList() {
+    if (renderListDirty) {
+        renderListDirty = false;
+        cachedRenderList.clear();
+        gatherMeshes(objects, cachedRenderList);
+    }
+    return cachedRenderList;
+}
+
 void RenderTarget::changeSize(sf::Vector2u newSize, bool deferred) {
     size_t n = newSize.x * newSize.y;
 
     framebuffer = vector<Color>(shadowMap ? 0 : n); // Shadowmaps only have z buffer
     zBuffer = vector<float>(n);
     bool useGBuffer = deferred && !shadowMap;
-    gBuffer = vector<Fragment>(useGBuffer ? n : 0);
+    gBuffer = vector<Fragment>(useGBuffer && gBufferLayout == GBufferLayout::Fragments ? n : 0);
+    packedGBuffer.resize(useGBuffer && gBufferLayout == GBufferLayout::Packed ? n : 0);
+    visibility = vector<uint32_t>(useGBuffer && gBufferLayout == GBufferLayout::Visibility ? n : 0);
     transparencyHeads = vector<uint32_t>(useGBuffer ? n : 0);
+    transparencyLayerFragments = vector<Fragment>(useGBuffer ? n * transparencyLayers : 0);
+    tileCount = {(newSize.x + tileSize - 1) / tileSize, (newSize.y + tileSize - 1) / tileSize};
+    tileBins = vector<vector<uint32_t>>(tileCount.x * tileCount.y);
+    hiZCount = {(newSize.x + hiZBlockSize - 1) / hiZBlockSize, (newSize.y + hiZBlockSize - 1) / hiZBlockSize};
+    hiZ = vector<DepthRange>(hiZCount.x * hiZCount.y);
+    hiZTiles = vector<DepthRange>(tileCount.x * tileCount.y);
 
     this->deferred = deferred;
     size = newSize;
 }
 
+void RenderTarget::clearDepth() {
+    std::fill(zBuffer.begin(), zBuffer.end(), INFINITY);
+    std::fill(hiZ.begin(), hiZ.end(), DepthRange{INFINITY, INFINITY});
+    std::fill(hiZTiles.begin(), hiZTiles.end(), DepthRange{INFINITY, INFINITY});
+}
+
+void RenderTarget::clearTransparency() {
+    static std::atomic<uint32_t> generations = 0; // Unique across render targets, so chunks of another one are never reused
+    std::fill(transparencyHeads.begin(), transparencyHeads.end(), transparencyLayers ? 0 : UINT32_MAX);
+    transparencyFragmentCount = 0;
+    transparencyGeneration = ++generations;
+}
+
+// Each thread reserves nodes in chunks, so the shared counter is rarely touched. Returns UINT32_MAX if the pool is full.
+uint32_t RenderTarget::allocateTransparentFragment() {
+    constexpr uint32_t chunkSize = 64;
+    thread_local struct {
+        uint32_t generation = 0, next = 0, end = 0;
+    } chunk;
+    if (chunk.generation != transparencyGeneration || chunk.next == chunk.end) {
+        uint32_t start = transparencyFragmentCount.fetch_add(chunkSize, std::memory_order_relaxed);
+        chunk = {transparencyGeneration, start, start + chunkSize};
+    }
+    uint32_t node = chunk.next++;
+    return node < transparencyFragments.size() ? node : UINT32_MAX;
+}
+
+// Only the thread drawing the pixel's tile may call this
+void RenderTarget::addTransparentFragment(size_t index, const Fragment &f) {
+    uint32_t &head = transparencyHeads[index];
+    if (transparencyLayers) {
+        Fragment *layers = &transparencyLayerFragments[index * transparencyLayers];
+        if (head < transparencyLayers) {
+            layers[head++] = f;
+            return;
+        }
+        // Full, the farthest layer gets dropped
+        Fragment *farthest = std::max_element(layers, layers + head, [](const Fragment &a, const Fragment &b) { return a.z < b.z; });
+        if (farthest->z > f.z)
+            *farthest = f;
+    } else {
+        uint32_t node = allocateTransparentFragment();
+        if (node == UINT32_MAX)
+            return;
+        transparencyFragments[node] = FragmentNode{f, head};
+        head = node;
+    }
+}
+
+// Recomputes a block's depth range from the z-buffer, then the range of its tile.
+// Depth only ever decreases, so the tile min can be updated in place, but its max has to be searched again when this block held it.
+void RenderTarget::updateHiZ(uint blockX, uint blockY) {
+    DepthRange &block = hiZ[blockX + blockY * hiZCount.x];
+    float oldMax = block.max;
+    block = {INFINITY, -INFINITY};
+    uint xEnd = std::min((blockX + 1) * hiZBlockSize, size.x);
+    uint yEnd = std::min((blockY + 1) * hiZBlockSize, size.y);
+    for (uint y = blockY * hiZBlockSize; y < yEnd; y++) {
+        for (uint x = blockX * hiZBlockSize; x < xEnd; x++) {
+            float z = zBuffer[x + y * size.x];
+            block.min = std::min(block.min, z);
+            block.max = std::max(block.max, z);
+        }
+    }
+
+    constexpr uint blocksPerTile = tileSize / hiZBlockSize;
+    uint tileX = blockX / blocksPerTile, tileY = blockY / blocksPerTile;
+    DepthRange &tile = hiZTiles[tileX + tileY * tileCount.x];
+    tile.min = std::min(tile.min, block.min);
+    if (oldMax == tile.max && block.max < oldMax) {
+        tile.max = -INFINITY;
+        uint bxEnd = std::min((tileX + 1) * blocksPerTile, hiZCount.x);
+        uint byEnd = std::min((tileY + 1) * blocksPerTile, hiZCount.y);
+        for (uint by = tileY * blocksPerTile; by < byEnd; by++)
+            for (uint bx = tileX * blocksPerTile; bx < bxEnd; bx++)
+                tile.max = std::max(tile.max, hiZ[bx + by * hiZCount.x].max);
+    }
+}
+
+// Farthest depth in the z-buffer over the pixels in [min, max), conservatively using whole tiles
+float RenderTarget::maxDepth(sf::Vector2i min, sf::Vector2i max) {
+    float result = -INFINITY;
+    for (uint ty = min.y / tileSize; ty <= (max.y - 1) / tileSize; ty++)
+        for (uint tx = min.x / tileSize; tx <= (max.x - 1) / tileSize; tx++) {
+            sf::Vector2i tileMin, tileMax;
+            tileBounds(tx + ty * tileCount.x, tileMin, tileMax);
+            if (min.x <= tileMin.x && min.y <= tileMin.y && max.x >= tileMax.x && max.y >= tileMax.y) {
+                result = std::max(result, hiZTiles[tx + ty * tileCount.x].max);
+                continue;
+            }
+            // Only part of the tile is covered, the blocks under that part are a tighter bound than the whole tile
+            uint bx0 = std::max(min.x, tileMin.x) / hiZBlockSize, bx1 = (std::min(max.x, tileMax.x) - 1) / hiZBlockSize;
+            uint by0 = std::max(min.y, tileMin.y) / hiZBlockSize, by1 = (std::min(max.y, tileMax.y) - 1) / hiZBlockSize;
+            for (uint by = by0; by <= by1; by++)
+                for (uint bx = bx0; bx <= bx1; bx++)
+                    result = std::max(result, hiZ[bx + by * hiZCount.x].max);
+        }
+    return result;
+}
+
 void Window::init()  {
     window = sf::RenderWindow(
         sf::VideoMode(size), name,
@@ -40,6 +168,17 @@ void Window::changeSize(Vector2u newSize) {
     }
 }
 
+sf::Image Window::presentPipelined() {
+    sf::Image image = presenting.valid() ? presenting.get() : sf::Image(frame->size);
+    std::swap(presentedFramebuffer, frame->framebuffer);
+    frame->framebuffer.resize(presentedFramebuffer.size()); // Was the last presented one, which may be from before a resize
+    float whitePoint = camera->whitePoint == 0 ? camera->maximumColor : camera->whitePoint;
+    presenting = std::async(std::launch::async, [this, size = frame->size, whitePoint] {
+        return tonemap(presentedFramebuffer, size, whitePoint);
+    });
+    return image;
+}
+
 void Window::changeFrameSize(Vector2u newSize) {
     frame->changeSize(newSize, frame->deferred);
     sf::FloatRect visibleArea({0.f, 0.f}, sf::Vector2f(newSize));
@@ -8,10 +8,14 @@
 #include "camera.h"
 #include <SFML/Graphics.hpp>
 #include "environmentMap.h"
+#include "gBuffer.h"
+#include "bvh.h"
 #include <SFML/System/Vector2.hpp>
 #include <SFML/Window/Event.hpp>
+#include <atomic>
 #include <cstdint>
 #include <functional>
+#include <future>
 #include <memory>
 #include <vector>
 
@@ -22,15 +26,63 @@ struct FragmentNode {
     uint32_t next;
 };
 
+struct DepthRange {
+    float min, max;
+};
+
+// How the deferred renderer stores opaque fragments between the geometry and deferred passes
+enum class GBufferLayout : uint8_t {
+    Fragments,  // Whole Fragment per pixel
+    Packed,     // PackedGBuffer
+    Visibility, // Triangle index per pixel, attributes are interpolated again in the deferred pass
+};
+
 struct RenderTarget {
     Vector2u size;
     vector<Color> framebuffer;
     vector<float> zBuffer;
+    // Hierarchical Z: depth range of each hiZBlockSize x hiZBlockSize block, and of each tile. Kept up to date by drawTriangle.
+    vector<DepthRange> hiZ;
+    vector<DepthRange> hiZTiles;
+    Vector2u hiZCount;
+    static constexpr uint hiZBlockSize = 8;
     vector<Fragment> gBuffer;
+    PackedGBuffer packedGBuffer;
+    // Id of the visible triangle, see Camera::opaqueTriangle, or UINT32_MAX
+    vector<uint32_t> visibility;
+    // Transparent fragments of each pixel, in no particular order, deferredPass sorts them.
+    // Normally they're linked lists in a pool shared by all threads, see allocateTransparentFragment.
     vector<FragmentNode> transparencyFragments;
-    vector<uint32_t> transparencyHeads;
+    std::atomic<uint32_t> transparencyFragmentCount = 0; // Can go past the pool size, then it has to be grown and drawn again
+    uint32_t transparencyGeneration = 0; // Changes whenever the pool is emptied
+    vector<uint32_t> transparencyHeads; // First node of each pixel's list, or with a k-buffer, the number of layers
+    // If not 0, each pixel only keeps the closest this many transparent fragments, in a fixed size k-buffer
+    uint transparencyLayers = 0;
+    vector<Fragment> transparencyLayerFragments;
+    // Weighted blended transparency: sum of weighted premultiplied colors (coverage in alpha), and product of transmittances.
+    // Only allocated while a scene using it is rendered.
+    vector<Color> transparencyAccumulation;
+    vector<Color> transparencyRevealage;
+    // Indices of the triangles overlapping each screen tile, in draw order. See Camera::drawTriangles.
+    vector<vector<uint32_t>> tileBins;
+    Vector2u tileCount;
+    static constexpr uint tileSize = 64; // Must be a multiple of hiZBlockSize
+    // Pixels of a tile, from min to max, exclusive
+    void tileBounds(size_t tile, sf::Vector2i &min, sf::Vector2i &max) const {
+        min = {(int)(tile % tileCount.x * tileSize), (int)(tile / tileCount.x * tileSize)};
+        max = {std::min(min.x + (int)tileSize, (int)size.x), std::min(min.y + (int)tileSize, (int)size.y)};
+    }
     bool deferred, shadowMap;
+    bool depthPrePass = false; // Only used in forward rendering
+    GBufferLayout gBufferLayout = GBufferLayout::Fragments; // Only used in deferred rendering, call changeSize after changing
     void changeSize(sf::Vector2u newSize, bool deferred);
+    void clearDepth();
+    void clearTransparency();
+    uint32_t allocateTransparentFragment();
+    void addTransparentFragment(size_t index, const Fragment &f);
+    void updateHiZ(uint blockX, uint blockY);
+    // Farthest depth in the pixels from min to max, exclusive, or a little farther, from the hi-Z blocks and tiles
+    float maxDepth(sf::Vector2i min, sf::Vector2i max);
 
     RenderTarget(Vector2u size, bool deferred = true, bool shadowMap = false) : shadowMap(shadowMap)
         { changeSize(size, deferred); }
@@ -69,6 +121,11 @@ extern FrameTimings timing;
 
 class Camera;
 
+enum class TransparencyMode : uint8_t {
+    Sorted,          // Exact: sorted per triangle in forward mode, per pixel in deferred mode
+    WeightedBlended, // Approximate, order independent, constant memory
+};
+
 struct Scene : public std::enable_shared_from_this<Scene> {
     std::string name;
     bool shouldUpdate = true;
@@ -78,6 +135,12 @@ struct Scene : public std::enable_shared_from_this<Scene> {
     Color ambientLight = {1, 1, 1, 0.1};
 
     std::vector<shared_ptr<Object>> objects;
+    SceneBVH bvh; // Updated by Camera::render
+
+    // Mesh components of every object, in scene tree order, so rendering doesn't have to walk the tree
+    const std::vector<MeshComponent *> &renderList();
+    // Call after adding or removing objects or components, the next renderList call rebuilds it, and the next bvh.update the BVH
+    void invalidateRenderList() { renderListDirty = true; bvh.invalidateItems(); }
 
     int renderMode = 0;
     bool backFaceCulling = true;
@@ -87,9 +150,14 @@ struct Scene : public std::enable_shared_from_this<Scene> {
     bool bilinearShadowFiltering = true;
     float shadowBias = 0.1f;
     TextureFilteringMode textureFilteringMode = TextureFilteringMode::NearestNeighbor;
+    TransparencyMode transparencyMode = TransparencyMode::Sorted;
 
     shared_ptr<Volume> volume;
     shared_ptr<EnvironmentMap> skyBox = std::make_shared<SolidEnvironmentMap>(Color{0, 0, 0, 0});
+
+  private:
+    std::vector<MeshComponent *> cachedRenderList;
+    bool renderListDirty = true;
 };
 
 class Window {
@@ -104,16 +172,32 @@ class Window {
     std::string name;
     Vector2u size{500, 500};
     bool syncFrameSize = true;
+    // Show each frame while the next one renders, one frame late. It's tonemapped on another thread, see presentPipelined.
+    bool pipelined = false;
     std::function<void()> gui;
     std::function<void(std::optional<sf::Event>)> onEvent;
+    sf::Texture texture; // The frame shown, kept so its memory is reused
+    // With pipelined, the last frame, swapped with the frame's framebuffer after rendering, and its image once tonemapped
+    vector<Color> presentedFramebuffer;
+    std::future<sf::Image> presenting;
+    // Left by the render thread, the window loop uploads it to texture once the frame is done
+    sf::Image renderedImage;
+    bool renderedImageReady = false;
+    // Events that may change the scene, handled once the render thread is done with it
+    vector<sf::Event> pendingEvents;
     
     void changeSize(Vector2u newSize);
     void changeFrameSize(Vector2u newSize);
+    // Image of the frame rendered before the last one, and starts tonemapping the last one. The first frame is black.
+    sf::Image presentPipelined();
 
     void init();
 };
 
 extern std::vector<std::weak_ptr<Scene>> scenes;
-extern std::shared_ptr<Window> currentWindow;
+extern std::shared_ptr<Window> currentWindow; // Window the GUI is being drawn for
+// Camera whose render pass the calling thread is running, set by each task of startThreads. Materials and textures take the
+// view and settings from it. Every thread has its own, so renders running side by side, even of different scenes, don't mix.
+extern thread_local Camera *shadingCamera;
 extern bool initComplete;
 #endif /* __DATA_H__ */
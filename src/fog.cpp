@@ -11,8 +11,8 @@ Color getVisibility(Color in, float sampleLength) {
 }
 
 void fogTransparency(Fragment &f, Color &pixel, float &z) {
-    auto camera = currentWindow->camera;
-    auto scene = currentWindow->scene;
+    Camera *camera = shadingCamera;
+    Scene *scene = camera->renderScene;
     shared_ptr<Volume> volume = f.isBackFace ? f.face->material->volumeFront : f.face->material->volumeBack;
     if(!volume) volume = scene->volume;
     if(volume && f.face->material->flags.transparent) { // Fog behind the fragment
@@ -41,8 +41,7 @@ Color sampleFog(Vec3 start, Vec3 end, Color background, Scene &scene, shared_ptr
             now += step;
             Color visibilityNow = remaining > sampleLength ? visibility : getVisibility(volume->intensity, remaining);
             Color lighting = {0,0,0,1};
-            for (size_t i = 0; i < scene.lights.size(); i++)
-                lighting += scene.lights[i]->sample(now, scene).first;
+            shadingCamera->forEachLight(now, [&](Light *light) { lighting += light->sample(now, scene).first; });
             color = Color::mix(lighting * volume->diffuse + volume->emissive, color, visibilityNow);
             remaining-= sampleLength;
         }
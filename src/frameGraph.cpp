@@ -0,0 +1,60 @@
+#include "frameGraph.h"
+#include "data.h"
+#include "light.h"
+#include "multithreading.h"
+#include <algorithm>
+
+void FrameGraph::addCamera(Camera *camera, std::vector<const void *> reads) {
+    std::vector<const void *> writes = {camera->frame};
+    if (!camera->shadowMap)
+        writes.push_back(&timing); // Only one camera can measure its passes at a time
+    // A window camera is a big render, as one task it would keep a single thread busy while the others wait
+    add({[camera] { camera->render(); }, std::move(reads), std::move(writes), !camera->shadowMap});
+}
+
+std::vector<const void *> FrameGraph::addScene(Scene &scene) {
+    // Render only refits the tree if it changed, so after this the cameras don't write to it
+    scene.bvh.update(scene.renderList());
+
+    std::vector<const void *> shadowMaps;
+    for (Light *light : scene.lights) {
+        SpotLight *spot = dynamic_cast<SpotLight *>(light);
+        if (!spot || !spot->shadowMap)
+            continue;
+        addCamera(spot->shadowMap);
+        shadowMaps.push_back(spot->shadowMap->frame);
+    }
+    return shadowMaps;
+}
+
+void FrameGraph::execute() {
+    auto &&shares = [](const std::vector<const void *> &a, const std::vector<const void *> &b) {
+        return std::find_first_of(a.begin(), a.end(), b.begin(), b.end()) != a.end();
+    };
+    // Nodes of a wave only depend on nodes of earlier waves
+    std::vector<size_t> wave(nodes.size());
+    size_t waveCount = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        for (size_t j = 0; j < i; j++)
+            if (shares(nodes[j].writes, nodes[i].reads) || shares(nodes[j].writes, nodes[i].writes) || shares(nodes[j].reads, nodes[i].writes))
+                wave[i] = std::max(wave[i], wave[j] + 1);
+        waveCount = std::max(waveCount, wave[i] + 1);
+    }
+
+    // Nodes of a wave don't depend on each other, so the ones running alone can go after the others
+    std::vector<RenderNode *> ready, alone;
+    for (size_t w = 0; w < waveCount; w++) {
+        ready.clear();
+        alone.clear();
+        for (size_t i = 0; i < nodes.size(); i++)
+            if (wave[i] == w)
+                (nodes[i].alone ? alone : ready).push_back(&nodes[i]);
+        if (ready.size() == 1)
+            ready[0]->run();
+        else
+            parallelFor(ready.size(), [&](size_t i) { ready[i]->run(); });
+        for (RenderNode *node : alone)
+            node->run();
+    }
+    nodes.clear();
+}
@@ -0,0 +1,35 @@
+#ifndef __FRAMEGRAPH_H__
+#define __FRAMEGRAPH_H__
+#include "camera.h"
+#include <functional>
+#include <vector>
+
+struct Scene;
+
+// One render of a frame, and what it shares with the other renders, usually RenderTargets
+struct RenderNode {
+    std::function<void()> run;
+    std::vector<const void *> reads, writes;
+    // Runs by itself, with its passes spread over all threads, instead of as one task next to the other nodes
+    bool alone = false;
+};
+
+// The renders of a frame. A node depends on the nodes added before it that write something it reads or writes,
+// or read something it writes, and nodes that don't depend on each other render in parallel.
+class FrameGraph {
+  public:
+    void add(RenderNode node) { nodes.push_back(std::move(node)); }
+    // Renders the camera into its frame, after the nodes that write reads. Window cameras run alone.
+    void addCamera(Camera *camera, std::vector<const void *> reads = {});
+    // Gets the scene ready for its cameras to render at the same time, and adds a node for each shadow map of its lights.
+    // Returns the shadow maps' frames, which the scene's cameras read.
+    std::vector<const void *> addScene(Scene &scene);
+    // Runs every node and removes them. Nodes that can run together are one task each, so their passes run on one thread.
+    // Nodes marked alone, and nodes with nothing to run together with, run one at a time with their passes on all threads.
+    void execute();
+
+  private:
+    std::vector<RenderNode> nodes;
+};
+
+#endif /* __FRAMEGRAPH_H__ */
@@ -0,0 +1,128 @@
+#include "gBuffer.h"
+#include "camera.h"
+#include "data.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+void PackedGBuffer::resize(size_t n) {
+    face = vector<Face*>(n, nullptr);
+    normal = vector<uint32_t>(n);
+    tangent = vector<uint32_t>(n);
+    bitangent = vector<uint32_t>(n);
+    uv = vector<uint32_t>(n);
+    dUVdx = vector<uint32_t>(n);
+    dUVdy = vector<uint32_t>(n);
+    isBackFace = vector<uint8_t>(n);
+}
+
+static uint32_t packHalf2(Vector2f v) {
+    return floatToHalf(v.x) | (uint32_t)floatToHalf(v.y) << 16;
+}
+
+static Vector2f unpackHalf2(uint32_t v) {
+    return {halfToFloat(v & 0xffff), halfToFloat(v >> 16)};
+}
+
+void PackedGBuffer::store(size_t i, const Fragment &f) {
+    face[i] = f.face;
+    normal[i] = encodeOctahedral(f.normal);
+    if (f.face->material->needsTBN) {
+        tangent[i] = encodeOctahedral(f.tangent);
+        bitangent[i] = encodeOctahedral(f.bitangent);
+    }
+    uv[i] = packHalf2(f.uv);
+    dUVdx[i] = packHalf2(f.dUVdx);
+    dUVdy[i] = packHalf2(f.dUVdy);
+    isBackFace[i] = f.isBackFace;
+}
+
+Fragment PackedGBuffer::load(Camera *camera, uint x, uint y, float z) const {
+    size_t i = x + y * camera->frame->size.x;
+    bool needsTBN = face[i]->material->needsTBN;
+    return Fragment{
+        .screenPos = {(int)x, (int)y},
+        .z = z,
+        .worldPos = camera->screenSpaceToWorldSpace(x + 0.5f, y + 0.5f, z), // Pixel center, where it was rasterized
+        .normal = decodeOctahedral(normal[i]),
+        .tangent = needsTBN ? decodeOctahedral(tangent[i]) : Vec3{},
+        .bitangent = needsTBN ? decodeOctahedral(bitangent[i]) : Vec3{},
+        .uv = unpackHalf2(uv[i]),
+        .dUVdx = unpackHalf2(dUVdx[i]),
+        .dUVdy = unpackHalf2(dUVdy[i]),
+        .face = face[i],
+        .isBackFace = (bool)isBackFace[i],
+    };
+}
+
+// IEEE 754 binary16, rounded to nearest even
+uint16_t floatToHalf(float value) {
+    uint32_t bits = std::bit_cast<uint32_t>(value);
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff) // Infinity or NaN
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    if (exponent >= 31) // Too big
+        return sign | 0x7c00;
+    if (exponent <= 0) { // Subnormal or zero
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return sign | half;
+    }
+    uint32_t half = sign | exponent << 10 | mantissa >> 13;
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++; // May carry into the exponent, which is still correct
+    return half;
+}
+
+float halfToFloat(uint16_t value) {
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+
+    if (exponent == 0) { // Subnormal or zero
+        float result = std::ldexp((float)mantissa, -24);
+        return sign ? -result : result;
+    }
+    if (exponent == 31) // Infinity or NaN
+        return std::bit_cast<float>(sign | 0x7f800000 | mantissa << 13);
+    return std::bit_cast<float>(sign | (exponent + 112) << 23 | mantissa << 13);
+}
+
+// Projects the unit vector onto an octahedron and unfolds it into a square, then stores each axis as a 16 bit snorm
+uint32_t encodeOctahedral(Vec3 n) {
+    float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (sum == 0)
+        return 0;
+    n *= 1 / sum;
+    Vector2f p{n.x, n.y};
+    if (n.z < 0)
+        p = {
+            (1 - std::abs(n.y)) * (n.x >= 0 ? 1 : -1),
+            (1 - std::abs(n.x)) * (n.y >= 0 ? 1 : -1),
+        };
+    auto &&toSnorm = [](float v) { return (uint32_t)(uint16_t)(int16_t)std::round(std::clamp(v, -1.0f, 1.0f) * 32767); };
+    return toSnorm(p.x) | toSnorm(p.y) << 16;
+}
+
+Vec3 decodeOctahedral(uint32_t encoded) {
+    Vector2f p{
+        std::max((int16_t)(encoded & 0xffff) / 32767.0f, -1.0f),
+        std::max((int16_t)(encoded >> 16) / 32767.0f, -1.0f),
+    };
+    Vec3 n{p.x, p.y, 1 - std::abs(p.x) - std::abs(p.y)};
+    if (n.z < 0) {
+        n.x = (1 - std::abs(p.y)) * (p.x >= 0 ? 1 : -1);
+        n.y = (1 - std::abs(p.x)) * (p.y >= 0 ? 1 : -1);
+    }
+    return n.normalized();
+}
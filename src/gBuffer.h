@@ -0,0 +1,30 @@
+#ifndef __GBUFFER_H__
+#define __GBUFFER_H__
+
+#include "miscTypes.h"
+#include <cstdint>
+
+class Camera;
+
+// G-buffer with one plane per attribute, quantized to about 33 bytes per pixel instead of a whole Fragment.
+// Normals are octahedral with 16 bits per axis, UVs and their derivatives are half floats,
+// and world position isn't stored at all but reconstructed from the z-buffer.
+struct PackedGBuffer {
+    vector<Face*> face; // nullptr if there's no opaque fragment
+    vector<uint32_t> normal;
+    vector<uint32_t> tangent, bitangent; // Only written for materials that need TBN
+    vector<uint32_t> uv, dUVdx, dUVdy;
+    vector<uint8_t> isBackFace;
+
+    void resize(size_t n);
+    void store(size_t i, const Fragment &f);
+    // Only reads the planes the fragment's material uses
+    Fragment load(Camera *camera, uint x, uint y, float z) const;
+};
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+uint32_t encodeOctahedral(Vec3 normal);
+Vec3 decodeOctahedral(uint32_t encoded);
+
+#endif /* __GBUFFER_H__ */
@@ -32,19 +32,19 @@ void subdivideMesh2(shared_ptr<Mesh> mesh) {
     // Inner vector is list of adjacent vertices
     // Pair: adjacent vertex index, middle point vertex index
     // Goal: when subdividing two adjacent faces, the shared edge would have a middle vertex created twice. Try to deduplicate them
-    vector<vector<std::pair<int, int>>> cache(mesh->vertices.size());
+    vector<vector<std::pair<uint32_t, uint32_t>>> cache(mesh->vertices.size());
 
-    auto splitEdge = [&](uint16_t i1, uint16_t i2) -> uint16_t {
-        uint16_t i_1 = std::min(i1, i2); // sort i1/i2
-        uint16_t i_2 = std::max(i1, i2);
-        vector<std::pair<int, int>> &neighbors = cache[i_1];
-        auto found = std::find_if(neighbors.begin(), neighbors.end(), [&](const std::pair<int, int> &p) {
+    auto splitEdge = [&](uint32_t i1, uint32_t i2) -> uint32_t {
+        uint32_t i_1 = std::min(i1, i2); // sort i1/i2
+        uint32_t i_2 = std::max(i1, i2);
+        vector<std::pair<uint32_t, uint32_t>> &neighbors = cache[i_1];
+        auto found = std::find_if(neighbors.begin(), neighbors.end(), [&](const std::pair<uint32_t, uint32_t> &p) {
             return p.first == i_2;
         });
         if (found == neighbors.end()) { // not found, make it then
             Vertex &v1 = mesh->vertices[i_1];
             Vertex &v2 = mesh->vertices[i_2];
-            uint16_t iNew = mesh->vertices.size();
+            uint32_t iNew = mesh->vertices.size();
             mesh->vertices.emplace_back(
                 0.5f * (v1.position + v2.position),
                 0.5f * (v1.uv + v2.uv),
@@ -59,9 +59,9 @@ void subdivideMesh2(shared_ptr<Mesh> mesh) {
     size_t n_face = mesh->faces.size(); // Since faces are added inside the loop, size changes. Keep initial size cuz we're only iterating over existing ones
     for (size_t i = 0; i < n_face; i++) {
         Face f = mesh->faces[i];
-        uint16_t v1 = splitEdge(f.v2, f.v3);
-        uint16_t v2 = splitEdge(f.v1, f.v3);
-        uint16_t v3 = splitEdge(f.v1, f.v2);
+        uint32_t v1 = splitEdge(f.v2, f.v3);
+        uint32_t v2 = splitEdge(f.v1, f.v3);
+        uint32_t v3 = splitEdge(f.v1, f.v2);
         mesh->faces.emplace_back(f.v3, v2, v1, f.material);
         mesh->faces.emplace_back(v3, f.v2, v1, f.material);
         mesh->faces.emplace_back(v3, v2, f.v1, f.material);
@@ -75,19 +75,19 @@ void subdivideMesh3(shared_ptr<Mesh> mesh) {
     // Inner vector is list of adjacent vertices
     // Pair: adjacent vertex index, first middle point vertex index
     // Goal: when subdividing two adjacent faces, the shared edge would have the middle vertices created twice. Try to deduplicate them
-    vector<vector<std::pair<int, int>>> cache(mesh->vertices.size());
+    vector<vector<std::pair<uint32_t, uint32_t>>> cache(mesh->vertices.size());
 
-    auto splitEdge = [&](uint16_t i1, uint16_t i2) -> uint16_t {
-        uint16_t i_1 = std::min(i1, i2); // sort i1/i2
-        uint16_t i_2 = std::max(i1, i2);
-        vector<std::pair<int, int>> &neighbors = cache[i_1];
-        auto found = std::find_if(neighbors.begin(), neighbors.end(), [&](const std::pair<int, int> &p) {
+    auto splitEdge = [&](uint32_t i1, uint32_t i2) -> uint32_t {
+        uint32_t i_1 = std::min(i1, i2); // sort i1/i2
+        uint32_t i_2 = std::max(i1, i2);
+        vector<std::pair<uint32_t, uint32_t>> &neighbors = cache[i_1];
+        auto found = std::find_if(neighbors.begin(), neighbors.end(), [&](const std::pair<uint32_t, uint32_t> &p) {
             return p.first == i_2;
         });
         if (found == neighbors.end()) { // not found, make it then
             Vertex &v1 = mesh->vertices[i_1];
             Vertex &v2 = mesh->vertices[i_2];
-            uint16_t iNew = mesh->vertices.size();
+            uint32_t iNew = mesh->vertices.size();
             mesh->vertices.emplace_back(
                 (1/3.0f) * (2.0f*v1.position + v2.position),
                 (1/3.0f) * (2.0f*v1.uv + v2.uv),
@@ -107,10 +107,10 @@ void subdivideMesh3(shared_ptr<Mesh> mesh) {
     size_t n_face = mesh->faces.size(); // Since faces are added inside the loop, size changes. Keep initial size cuz we're only iterating over existing ones
     for (size_t i = 0; i < n_face; i++) {
         Face f = mesh->faces[i];
-        uint16_t v_1 = splitEdge(f.v2, f.v3);
-        uint16_t v_2 = splitEdge(f.v1, f.v3);
-        uint16_t v_3 = splitEdge(f.v1, f.v2);
-        uint16_t v111 = f.v1, v222 = f.v2, v333 = f.v3, 
+        uint32_t v_1 = splitEdge(f.v2, f.v3);
+        uint32_t v_2 = splitEdge(f.v1, f.v3);
+        uint32_t v_3 = splitEdge(f.v1, f.v2);
+        uint32_t v111 = f.v1, v222 = f.v2, v333 = f.v3, 
                  v112, v122, v223, v233, v113, v133, v123;
         if(f.v1 > f.v2) {
             v112 = v_3 + 1; v122 = v_3;
@@ -185,8 +185,8 @@ shared_ptr<Mesh> makeDodecahedron(string name, shared_ptr<Material> mat, bool pe
     }
 
     // Triangulates a pentagonal face.
-    auto makeFace = [&](uint16_t v1, uint16_t v2, uint16_t v3, uint16_t v4, uint16_t v5) {
-        uint16_t i = vertices.size();
+    auto makeFace = [&](uint32_t v1, uint32_t v2, uint32_t v3, uint32_t v4, uint32_t v5) {
+        uint32_t i = vertices.size();
         Vec3 pos = 0.2f * (vertices[v1].position + vertices[v2].position +
                                vertices[v3].position + vertices[v4].position +
                                vertices[v5].position);
@@ -305,11 +305,11 @@ shared_ptr<Mesh> makeCubeSphere(string name, std::array<shared_ptr<Material>, 6>
                     .normal = -position.normalized(),
                 });
                 if (x > 0 && y > 0) {
-                    uint16_t sideOffset = (n * (subdivisions+1) * (subdivisions+1));
-                    uint16_t v1 = (x - 1) + (y - 1) * (subdivisions + 1) + sideOffset;
-                    uint16_t v2 = (x - 0) + (y - 1) * (subdivisions + 1) + sideOffset;
-                    uint16_t v3 = (x - 1) + (y - 0) * (subdivisions + 1) + sideOffset;
-                    uint16_t v4 = (x - 0) + (y - 0) * (subdivisions + 1) + sideOffset;
+                    uint32_t sideOffset = (n * (subdivisions+1) * (subdivisions+1));
+                    uint32_t v1 = (x - 1) + (y - 1) * (subdivisions + 1) + sideOffset;
+                    uint32_t v2 = (x - 0) + (y - 1) * (subdivisions + 1) + sideOffset;
+                    uint32_t v3 = (x - 1) + (y - 0) * (subdivisions + 1) + sideOffset;
+                    uint32_t v4 = (x - 0) + (y - 0) * (subdivisions + 1) + sideOffset;
                     mesh->faces.push_back(Face{
                         .v1 = v2, .v2 = v1, .v3 = v4,
                         .material = mats[n]
@@ -0,0 +1,198 @@
+#include "generateMesh.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+
+using std::string, std::shared_ptr;
+
+// Sum of squared distances to a set of planes, as a symmetric 4x4 matrix (Garland & Heckbert)
+struct Quadric {
+    std::array<double, 10> q{};
+
+    static Quadric plane(Vec3 n, float d, double weight) {
+        double a = n.x, b = n.y, c = n.z;
+        return {{
+            a * a * weight, a * b * weight, a * c * weight, a * d * weight,
+                            b * b * weight, b * c * weight, b * d * weight,
+                                            c * c * weight, c * d * weight,
+                                                            d * d * weight,
+        }};
+    }
+    Quadric &operator+=(const Quadric &other) {
+        for (int i = 0; i < 10; i++)
+            q[i] += other.q[i];
+        return *this;
+    }
+    double error(Vec3 p) const {
+        double x = p.x, y = p.y, z = p.z;
+        return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+                            +     q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+                                               +     q[7] * z * z + 2 * q[8] * z
+                                                                  +     q[9];
+    }
+};
+
+// Collapses edges in order of increasing error until the mesh has at most targetFaces faces.
+// A vertex is always collapsed into one of its neighbors, so UVs and normals don't have to be interpolated.
+// Vertices on open borders, UV seams (which are open borders, since the vertices are split there) and
+// material boundaries never move, so the silhouette and texture mapping stay intact.
+shared_ptr<Mesh> simplifyMesh(const Mesh &mesh, size_t targetFaces) {
+    size_t vertexCount = mesh.vertices.size();
+    vector<std::array<uint32_t, 3>> faces(mesh.faces.size());
+    for (size_t i = 0; i < faces.size(); i++)
+        faces[i] = {mesh.faces[i].v1, mesh.faces[i].v2, mesh.faces[i].v3};
+    vector<bool> faceRemoved(faces.size());
+    size_t faceCount = faces.size();
+
+    vector<Quadric> quadrics(vertexCount);
+    vector<vector<uint32_t>> vertexFaces(vertexCount);
+    for (size_t i = 0; i < faces.size(); i++) {
+        auto [a, b, c] = faces[i];
+        Vec3 pa = mesh.vertices[a].position, pb = mesh.vertices[b].position, pc = mesh.vertices[c].position;
+        Vec3 n = (pb - pa).cross(pc - pa);
+        float area = n.length();
+        if (area > 0)
+            n /= area;
+        Quadric q = Quadric::plane(n, -n.dot(pa), area);
+        for (uint32_t v : faces[i]) {
+            quadrics[v] += q;
+            vertexFaces[v].push_back(i);
+        }
+    }
+
+    // An edge shared by exactly two faces of the same material is inside the surface
+    vector<bool> locked(vertexCount);
+    std::unordered_map<uint64_t, std::pair<uint32_t, int>> edges; // First face, number of faces
+    auto &&edgeKey = [](uint32_t a, uint32_t b) { return (uint64_t)std::min(a, b) << 32 | std::max(a, b); };
+    for (size_t i = 0; i < faces.size(); i++)
+        for (int j = 0; j < 3; j++) {
+            auto [it, inserted] = edges.try_emplace(edgeKey(faces[i][j], faces[i][(j + 1) % 3]), i, 0);
+            it->second.second++;
+            if (mesh.faces[it->second.first].material != mesh.faces[i].material)
+                it->second.second = 3;
+        }
+    for (auto &&[key, edge] : edges)
+        if (edge.second != 2)
+            locked[key >> 32] = locked[key & UINT32_MAX] = true;
+
+    struct Collapse {
+        double cost;
+        uint32_t from, to;
+        uint32_t fromStamp, toStamp;
+        bool operator>(const Collapse &other) const { return cost > other.cost; }
+    };
+    vector<uint32_t> stamps(vertexCount); // Changes whenever a vertex changes, so queued collapses using it are skipped
+    vector<bool> vertexRemoved(vertexCount);
+    std::priority_queue<Collapse, vector<Collapse>, std::greater<Collapse>> queue;
+    auto &&push = [&](uint32_t a, uint32_t b) {
+        Quadric q = quadrics[a];
+        q += quadrics[b];
+        if (!locked[a])
+            queue.push({q.error(mesh.vertices[b].position), a, b, stamps[a], stamps[b]});
+        if (!locked[b])
+            queue.push({q.error(mesh.vertices[a].position), b, a, stamps[b], stamps[a]});
+    };
+    for (auto &&[key, edge] : edges)
+        push(key >> 32, key & UINT32_MAX);
+
+    while (faceCount > targetFaces && !queue.empty()) {
+        Collapse c = queue.top();
+        queue.pop();
+        if (vertexRemoved[c.from] || vertexRemoved[c.to] || stamps[c.from] != c.fromStamp || stamps[c.to] != c.toStamp)
+            continue;
+
+        // Moving the vertex must not flip any of the faces that stay
+        Vec3 target = mesh.vertices[c.to].position;
+        bool flips = false;
+        for (uint32_t f : vertexFaces[c.from]) {
+            if (faceRemoved[f])
+                continue;
+            auto &face = faces[f];
+            if (std::find(face.begin(), face.end(), c.to) != face.end())
+                continue;
+            Vec3 p[3], moved[3];
+            for (int j = 0; j < 3; j++) {
+                p[j] = mesh.vertices[face[j]].position;
+                moved[j] = face[j] == c.from ? target : p[j];
+            }
+            Vec3 before = (p[1] - p[0]).cross(p[2] - p[0]), after = (moved[1] - moved[0]).cross(moved[2] - moved[0]);
+            if (before.dot(after) <= 0) {
+                flips = true;
+                break;
+            }
+        }
+        if (flips)
+            continue;
+
+        for (uint32_t f : vertexFaces[c.from]) {
+            if (faceRemoved[f])
+                continue;
+            auto &face = faces[f];
+            if (std::find(face.begin(), face.end(), c.to) != face.end()) {
+                faceRemoved[f] = true;
+                faceCount--;
+                continue;
+            }
+            std::replace(face.begin(), face.end(), c.from, c.to);
+            vertexFaces[c.to].push_back(f);
+        }
+        vertexRemoved[c.from] = true;
+        quadrics[c.to] += quadrics[c.from];
+        stamps[c.to]++;
+
+        // Costs of the edges around the merged vertex changed
+        vector<uint32_t> &around = vertexFaces[c.to];
+        around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t f) { return faceRemoved[f]; }), around.end());
+        for (uint32_t f : around)
+            for (uint32_t v : faces[f])
+                if (v != c.to)
+                    push(c.to, v);
+    }
+
+    // Keep only the vertices that are still used
+    vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    vector<Vertex> newVertices;
+    vector<Face> newFaces;
+    for (size_t i = 0; i < faces.size(); i++) {
+        if (faceRemoved[i])
+            continue;
+        uint32_t indices[3];
+        for (int j = 0; j < 3; j++) {
+            uint32_t v = faces[i][j];
+            if (remap[v] == UINT32_MAX) {
+                remap[v] = newVertices.size();
+                newVertices.push_back(mesh.vertices[v]);
+            }
+            indices[j] = remap[v];
+        }
+        newFaces.push_back({indices[0], indices[1], indices[2], mesh.faces[i].material});
+    }
+    shared_ptr<Mesh> result = std::make_shared<Mesh>(mesh.label, newVertices, newFaces, mesh.flatShading);
+    result->version = mesh.version;
+    return result;
+}
+
+void buildLODs(Mesh &mesh, size_t levels) {
+    std::lock_guard lock(meshCacheMutex);
+    if (mesh.lodVersion == mesh.version && mesh.lodsRequested >= levels)
+        return;
+    if (mesh.lodVersion != mesh.version)
+        mesh.lods.clear();
+    mesh.lodVersion = mesh.version;
+    mesh.lodsRequested = levels;
+
+    while (mesh.lods.size() < levels) {
+        Mesh &previous = mesh.lods.empty() ? mesh : *mesh.lods.back();
+        // Tiny meshes have nothing left to remove
+        if (previous.faces.size() < 16)
+            break;
+        shared_ptr<Mesh> lod = simplifyMesh(previous, previous.faces.size() / 2);
+        if (lod->faces.size() > previous.faces.size() * 9 / 10)
+            break; // Everything left is locked
+        lod->label = mesh.label + " LOD " + std::to_string(mesh.lods.size() + 1);
+        mesh.lods.push_back(lod);
+    }
+}
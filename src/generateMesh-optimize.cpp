@@ -0,0 +1,155 @@
+#include "generateMesh.h"
+#include <algorithm>
+#include <cmath>
+
+// Size of the simulated cache, for both reordering and measuring
+constexpr int vertexCacheSize = 32;
+
+float vertexCacheMissRatio(const Mesh &mesh) {
+    if (mesh.faces.empty())
+        return 0;
+    // Least recently used first
+    vector<uint32_t> cache;
+    size_t misses = 0;
+    for (auto &&face : mesh.faces) {
+        for (uint32_t v : {face.v1, face.v2, face.v3}) {
+            auto it = std::find(cache.begin(), cache.end(), v);
+            if (it != cache.end()) {
+                cache.erase(it);
+            } else {
+                misses++;
+                if (cache.size() == vertexCacheSize)
+                    cache.erase(cache.begin());
+            }
+            cache.push_back(v);
+        }
+    }
+    return (float)misses / mesh.faces.size();
+}
+
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation". Greedily adds the triangle whose vertices score the highest,
+// a vertex scores high if it was used recently, and if few of its triangles are left so it can be dropped from the cache.
+static float vertexScore(int cachePosition, size_t remainingFaces) {
+    if (remainingFaces == 0)
+        return -1;
+    float score = 0;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) // Used by the last triangle, its score shouldn't depend on which corner it was
+            score = 0.75f;
+        else
+            score = std::pow(1 - (float)(cachePosition - 3) / (vertexCacheSize - 3), 1.5f);
+    }
+    return score + 2 * std::pow((float)remainingFaces, -0.5f);
+}
+
+void optimizeVertexCache(Mesh &mesh) {
+    size_t vertexCount = mesh.vertices.size(), faceCount = mesh.faces.size();
+
+    // Faces of each vertex, the first remaining[v] of them are the ones not added yet
+    vector<uint32_t> faceStart(vertexCount + 1), vertexFaces(faceCount * 3), remaining(vertexCount);
+    for (auto &&face : mesh.faces)
+        for (uint32_t v : {face.v1, face.v2, face.v3})
+            remaining[v]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        faceStart[v + 1] = faceStart[v] + remaining[v];
+    vector<uint32_t> fill(faceStart.begin(), faceStart.end() - 1);
+    for (size_t f = 0; f < faceCount; f++)
+        for (uint32_t v : {mesh.faces[f].v1, mesh.faces[f].v2, mesh.faces[f].v3})
+            vertexFaces[fill[v]++] = f;
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> score(vertexCount), faceScore(faceCount);
+    vector<bool> added(faceCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, remaining[v]);
+    for (size_t f = 0; f < faceCount; f++)
+        faceScore[f] = score[mesh.faces[f].v1] + score[mesh.faces[f].v2] + score[mesh.faces[f].v3];
+
+    vector<Face> ordered;
+    ordered.reserve(faceCount);
+    vector<uint32_t> cache, newCache;
+    size_t scanFrom = 0; // Faces before this have all been added
+    while (ordered.size() < faceCount) {
+        // Best face using a cached vertex, if there is none, the best face of all
+        int64_t best = -1;
+        for (uint32_t v : cache)
+            for (uint32_t i = faceStart[v]; i < faceStart[v] + remaining[v]; i++)
+                if (best < 0 || faceScore[vertexFaces[i]] > faceScore[best])
+                    best = vertexFaces[i];
+        if (best < 0) {
+            while (added[scanFrom])
+                scanFrom++;
+            for (size_t f = scanFrom; f < faceCount; f++)
+                if (!added[f] && (best < 0 || faceScore[f] > faceScore[best]))
+                    best = f;
+        }
+
+        Face &face = mesh.faces[best];
+        added[best] = true;
+        ordered.push_back(face);
+
+        // Move the face's vertices to the front of the cache, and forget about the face
+        newCache.clear();
+        for (uint32_t v : {face.v1, face.v2, face.v3}) {
+            newCache.push_back(v);
+            uint32_t *faces = &vertexFaces[faceStart[v]];
+            std::iter_swap(std::find(faces, faces + remaining[v], (uint32_t)best), faces + remaining[v] - 1);
+            remaining[v]--;
+        }
+        for (uint32_t v : cache)
+            if (v != face.v1 && v != face.v2 && v != face.v3)
+                newCache.push_back(v);
+        for (size_t i = vertexCacheSize; i < newCache.size(); i++)
+            cachePosition[newCache[i]] = -1;
+        if (newCache.size() > vertexCacheSize)
+            newCache.resize(vertexCacheSize);
+        std::swap(cache, newCache);
+
+        // Only scores of cached vertices, and the ones that just fell out of it, changed
+        auto &&rescore = [&](uint32_t v) {
+            score[v] = vertexScore(cachePosition[v], remaining[v]);
+            for (uint32_t i = faceStart[v]; i < faceStart[v] + remaining[v]; i++) {
+                const Face &f = mesh.faces[vertexFaces[i]];
+                faceScore[vertexFaces[i]] = score[f.v1] + score[f.v2] + score[f.v3];
+            }
+        };
+        for (size_t i = 0; i < cache.size(); i++)
+            cachePosition[cache[i]] = i;
+        for (size_t i = 0; i < cache.size(); i++)
+            score[cache[i]] = vertexScore(i, remaining[cache[i]]);
+        for (uint32_t v : newCache)
+            if (cachePosition[v] < 0)
+                rescore(v);
+        for (uint32_t v : cache)
+            rescore(v);
+    }
+
+    mesh.faces = std::move(ordered);
+    mesh.version++;
+}
+
+// Numbers vertices in the order the faces first use them, so they're read from memory mostly sequentially.
+// Vertices no face uses are dropped.
+void optimizeVertexFetch(Mesh &mesh) {
+    vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (auto &&face : mesh.faces) {
+        for (uint32_t *v : {&face.v1, &face.v2, &face.v3}) {
+            if (remap[*v] == UINT32_MAX) {
+                remap[*v] = vertices.size();
+                vertices.push_back(mesh.vertices[*v]);
+            }
+            *v = remap[*v];
+        }
+    }
+    mesh.vertices = std::move(vertices);
+    mesh.version++;
+}
+
+std::pair<float, float> optimizeMesh(Mesh &mesh) {
+    float before = vertexCacheMissRatio(mesh);
+    optimizeVertexCache(mesh);
+    optimizeVertexFetch(mesh);
+    return {before, vertexCacheMissRatio(mesh)};
+}
@@ -8,14 +8,14 @@
 /// Usually 1x1 is enough, unless the face is very big, in which case it might be a good idea to increase it.
 /// @param subdivisionsY 
 /// @return Pointer to mesh object
-shared_ptr<Mesh> createPlane(shared_ptr<Material> material, std::string name, uint16_t subdivisionsX, uint16_t subdivisionsY) {
+shared_ptr<Mesh> createPlane(shared_ptr<Material> material, std::string name, uint32_t subdivisionsX, uint32_t subdivisionsY) {
     // Allocate the mesh and assign a label.
     shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
     mesh->label = name;
 
     // Calculate the number of vertices and faces.
-    uint16_t numVertices = (subdivisionsX + 1) * (subdivisionsY + 1);
-    uint16_t numFaces = subdivisionsX * subdivisionsY * 2;
+    uint32_t numVertices = (subdivisionsX + 1) * (subdivisionsY + 1);
+    uint32_t numFaces = subdivisionsX * subdivisionsY * 2;
 
     // Allocate memory for vertices and faces.
     mesh->faces = vector<Face>(numFaces);
@@ -26,9 +26,9 @@ shared_ptr<Mesh> createPlane(shared_ptr<Material> material, std::string name, ui
     float stepY = 1.0f / subdivisionsY;
 
     // Generate vertices.
-    uint16_t vertexIndex = 0;
-    for (uint16_t y = 0; y <= subdivisionsY; ++y) {
-        for (uint16_t x = 0; x <= subdivisionsX; ++x) {
+    uint32_t vertexIndex = 0;
+    for (uint32_t y = 0; y <= subdivisionsY; ++y) {
+        for (uint32_t x = 0; x <= subdivisionsX; ++x) {
             float posX = -0.5f + x * stepX;
             float posY = -0.5f + y * stepY;
 
@@ -42,13 +42,13 @@ shared_ptr<Mesh> createPlane(shared_ptr<Material> material, std::string name, ui
     }
 
     // Generate faces.
-    uint16_t faceIndex = 0;
-    for (uint16_t y = 0; y < subdivisionsY; ++y) {
-        for (uint16_t x = 0; x < subdivisionsX; ++x) {
-            uint16_t topLeft = y * (subdivisionsX + 1) + x;
-            uint16_t topRight = topLeft + 1;
-            uint16_t bottomLeft = (y + 1) * (subdivisionsX + 1) + x;
-            uint16_t bottomRight = bottomLeft + 1;
+    uint32_t faceIndex = 0;
+    for (uint32_t y = 0; y < subdivisionsY; ++y) {
+        for (uint32_t x = 0; x < subdivisionsX; ++x) {
+            uint32_t topLeft = y * (subdivisionsX + 1) + x;
+            uint32_t topRight = topLeft + 1;
+            uint32_t bottomLeft = (y + 1) * (subdivisionsX + 1) + x;
+            uint32_t bottomRight = bottomLeft + 1;
 
             // First triangle of the quad.
             mesh->faces[faceIndex++] = {topLeft, bottomLeft, topRight, material};
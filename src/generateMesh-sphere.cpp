@@ -21,26 +21,26 @@ Vector2f invertUV(Vector2f a, bool invertU, bool invertV) {
 /// @param stacks Number of vertical subdivisions (10-20 is good)
 /// @param sectors Number of horizontal subdivisions (20 is good)
 /// @return Pointer to mesh object
-shared_ptr<Mesh> makeSphere(shared_ptr<Material> material, std::string name, uint16_t stacks, uint16_t sectors, bool invertU, bool invertV) {
+shared_ptr<Mesh> makeSphere(shared_ptr<Material> material, std::string name, uint32_t stacks, uint32_t sectors, bool invertU, bool invertV) {
     // Allocate the mesh and assign a label.
     shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
     mesh->label = name;
     
     // Calculate number of vertices:
     // There will be (stacks + 1) rows and (sectors + 1) columns of vertices.
-    uint16_t numVertices = (stacks + 1) * (sectors + 1);
+    uint32_t numVertices = (stacks + 1) * (sectors + 1);
     mesh->vertices = vector<Vertex>(numVertices);
     
     // Create vertices using spherical coordinates.
     // The sphere is assumed to have a radius of 1.
     // "phi" is the angle from the positive Y-axis, and "theta" is the angle around the Y-axis.
-    for (uint16_t i = 0; i <= stacks; ++i) {
+    for (uint32_t i = 0; i <= stacks; ++i) {
         float phi = M_PI * i / stacks;  // 0..pi
-        for (uint16_t j = 0; j <= sectors; ++j) {
+        for (uint32_t j = 0; j <= sectors; ++j) {
             float theta = 2.0f * M_PI * j / sectors;  // 0..2pi
 
             // Compute the vertex index.
-            uint16_t index = i * (sectors + 1) + j;
+            uint32_t index = i * (sectors + 1) + j;
             
             // Spherical to Cartesian conversion.
             float x = std::sin(phi) * std::cos(theta);
@@ -63,18 +63,18 @@ shared_ptr<Mesh> makeSphere(shared_ptr<Material> material, std::string name, uin
     //   For each stack row (except the last),
     //   For each sector, add the triangles if they are not degenerate.
     // The total face count comes out to 2 * sectors * (stacks - 1).
-    uint16_t numFaces = 2 * sectors * (stacks - 1);
+    uint32_t numFaces = 2 * sectors * (stacks - 1);
     mesh->faces = vector<Face>(numFaces);
 
     // Build faces (triangles) using indices of the vertices.
     // We use counter-clockwise winding order (when looking from the outside)
     // which is standard in most rendering engines.
     int faceIndex = 0;
-    for (uint16_t i = 0; i < stacks; ++i) {
-        for (uint16_t j = 0; j < sectors; ++j) {
+    for (uint32_t i = 0; i < stacks; ++i) {
+        for (uint32_t j = 0; j < sectors; ++j) {
             // Indices for the current quad.
-            uint16_t k1 = i * (sectors + 1) + j;       // current row, current column
-            uint16_t k2 = (i + 1) * (sectors + 1) + j;   // next row, current column
+            uint32_t k1 = i * (sectors + 1) + j;       // current row, current column
+            uint32_t k2 = (i + 1) * (sectors + 1) + j;   // next row, current column
 
             // For the top stack, skip the first triangle (avoid degenerate cap)
             if (i != 0) {
@@ -102,7 +102,7 @@ shared_ptr<Mesh> makeSphere(shared_ptr<Material> material, std::string name, uin
     return mesh;
 }
 
-shared_ptr<Mesh> makeCylinder(shared_ptr<Material> material, std::string name, uint16_t sectors, shared_ptr<Material> endCap, shared_ptr<Material> startCap) {
+shared_ptr<Mesh> makeCylinder(shared_ptr<Material> material, std::string name, uint32_t sectors, shared_ptr<Material> endCap, shared_ptr<Material> startCap) {
     shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
     mesh->label = name;
 
@@ -113,7 +113,7 @@ shared_ptr<Mesh> makeCylinder(shared_ptr<Material> material, std::string name, u
     mesh->vertices = vector<Vertex>(sectors * (2 + hasStartCap + hasEndCap) + hasStartCap + hasEndCap);
     mesh->faces = vector<Face>(sectors * (2 + hasStartCap + hasEndCap));
 
-    uint16_t startCapVI = 0, endCapVI = 0;
+    uint32_t startCapVI = 0, endCapVI = 0;
     size_t startCapFI = 2 * sectors, endCapFI = 2 * sectors;
     if(hasStartCap) {
         startCapVI = 2 * sectors;
@@ -134,7 +134,7 @@ shared_ptr<Mesh> makeCylinder(shared_ptr<Material> material, std::string name, u
         };
     }
 
-    for (uint16_t i = 0; i < sectors; i++) {
+    for (uint32_t i = 0; i < sectors; i++) {
         float u = (float)i / sectors;
         float θ = M_PI * 2.0f * u;
         float x = sinf(θ) * 0.5, y = cosf(θ) * 0.5;
@@ -148,16 +148,16 @@ shared_ptr<Mesh> makeCylinder(shared_ptr<Material> material, std::string name, u
             .uv = {u, 1},
             .normal= {-x, -y, 0}
         };
-        uint16_t iNext = (i + 1) % sectors;
+        uint32_t iNext = (i + 1) % sectors;
         mesh->faces[i] = Face{
             iNext, 
-            (uint16_t)(sectors + i), 
+            (uint32_t)(sectors + i), 
             i, material
         };
         mesh->faces[sectors + i] = Face{
             iNext, 
-            (uint16_t)(sectors + iNext), 
-            (uint16_t)(sectors + i), material
+            (uint32_t)(sectors + iNext), 
+            (uint32_t)(sectors + i), material
         };
 
         if(hasStartCap) {
@@ -168,8 +168,8 @@ shared_ptr<Mesh> makeCylinder(shared_ptr<Material> material, std::string name, u
             };
             mesh->faces[startCapFI+i] = Face{
                 startCapVI,
-                (uint16_t)(startCapVI + 1 + iNext),
-                (uint16_t)(startCapVI + 1 + i),
+                (uint32_t)(startCapVI + 1 + iNext),
+                (uint32_t)(startCapVI + 1 + i),
                 startCap
             };
         }
@@ -181,8 +181,8 @@ shared_ptr<Mesh> makeCylinder(shared_ptr<Material> material, std::string name, u
             };
             mesh->faces[endCapFI+i] = Face{
                 endCapVI,
-                (uint16_t)(endCapVI + 1 + i),
-                (uint16_t)(endCapVI + 1 + iNext),
+                (uint32_t)(endCapVI + 1 + i),
+                (uint32_t)(endCapVI + 1 + iNext),
                 endCap
             };
         }
@@ -22,6 +22,8 @@ shared_ptr<Mesh> loadSTL(const std::filesystem::path& filename, shared_ptr<Mater
 
     std::vector<Vertex> vertices;
     std::vector<Face> faces;
+    // Every triangle has its own copy of its vertices in STL files. The mesh is flat shaded, so the face normals can go.
+    VertexWelder welder(vertices, true);
 
     if (isBinary) {
         // Binary STL format
@@ -39,15 +41,12 @@ shared_ptr<Mesh> loadSTL(const std::filesystem::path& filename, shared_ptr<Mater
             uint16_t attributeByteCount;
             file.read(reinterpret_cast<char*>(&attributeByteCount), sizeof(attributeByteCount));
 
-            uint16_t index1 = vertices.size();
-            uint16_t index2 = index1 + 1;
-            uint16_t index3 = index2 + 1;
-
-            vertices.push_back(Vertex{.position = v1, .normal = normal});
-            vertices.push_back(Vertex{.position = v2, .normal = normal});
-            vertices.push_back(Vertex{.position = v3, .normal = normal});
-
-            faces.push_back(Face{.v1 = index1, .v2 = index2, .v3 = index3, .material = mat});
+            faces.push_back(Face{
+                .v1 = welder.add(Vertex{.position = v1}),
+                .v2 = welder.add(Vertex{.position = v2}),
+                .v3 = welder.add(Vertex{.position = v3}),
+                .material = mat,
+            });
         }
     } else {
         // ASCII STL format
@@ -76,18 +75,17 @@ shared_ptr<Mesh> loadSTL(const std::filesystem::path& filename, shared_ptr<Mater
                 std::getline(file, line); // Skip "endloop"
                 std::getline(file, line); // Skip "endfacet"
 
-                uint16_t index1 = vertices.size();
-                uint16_t index2 = index1 + 1;
-                uint16_t index3 = index2 + 1;
-
-                vertices.push_back(Vertex{.position = v1, .normal = normal});
-                vertices.push_back(Vertex{.position = v2, .normal = normal});
-                vertices.push_back(Vertex{.position = v3, .normal = normal});
-
-                faces.push_back(Face{.v1 = index1, .v2 = index2, .v3 = index3, .material = mat});
+                faces.push_back(Face{
+                    .v1 = welder.add(Vertex{.position = v1}),
+                    .v2 = welder.add(Vertex{.position = v2}),
+                    .v3 = welder.add(Vertex{.position = v3}),
+                    .material = mat,
+                });
             }
         }
     }
 
-    return std::make_shared<Mesh>(name, vertices, faces, true);
+    shared_ptr<Mesh> mesh = std::make_shared<Mesh>(name, vertices, faces, true);
+    bakeMeshNormals(*mesh); // Used if flat shading is turned off
+    return mesh;
 }
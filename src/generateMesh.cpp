@@ -1,9 +1,12 @@
 #include "generateMesh.h"
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <fstream>
 #include <memory>
 
+std::mutex meshCacheMutex;
+
 void bakeMeshNormals(Mesh &mesh) {
     for (auto &&face : mesh.faces) {
         Vertex &v1 = mesh.vertices[face.v1];
@@ -22,6 +25,170 @@ void bakeMeshNormals(Mesh &mesh) {
             std::cerr << "A vertex has zero normal! "
                          "This usually happens when a face is winded incorrectly "
                          "and cancels out another face's normal." << std::endl;
+    mesh.version++;
+}
+
+const Bounds &Mesh::bounds() {
+    std::lock_guard lock(meshCacheMutex);
+    if (boundsVersion == version && boundsVertexCount == vertices.size())
+        return cachedBounds;
+    boundsVersion = version;
+    boundsVertexCount = vertices.size();
+
+    cachedBounds = Bounds{};
+    if (vertices.empty())
+        return cachedBounds;
+    cachedBounds.min = cachedBounds.max = vertices[0].position;
+    for (auto &&v : vertices) {
+        cachedBounds.min = {std::min(cachedBounds.min.x, v.position.x), std::min(cachedBounds.min.y, v.position.y), std::min(cachedBounds.min.z, v.position.z)};
+        cachedBounds.max = {std::max(cachedBounds.max.x, v.position.x), std::max(cachedBounds.max.y, v.position.y), std::max(cachedBounds.max.z, v.position.z)};
+    }
+    // Center of the box isn't the smallest sphere, but it's close and doesn't need another pass to find
+    cachedBounds.center = (cachedBounds.min + cachedBounds.max) / 2;
+    float radiusSquared = 0;
+    for (auto &&v : vertices)
+        radiusSquared = std::max(radiusSquared, (v.position - cachedBounds.center).lengthSquared());
+    cachedBounds.radius = std::sqrt(radiusSquared);
+    return cachedBounds;
+}
+
+// Grows each meshlet from the first face not in one yet, adding the neighboring face that needs the fewest new
+// vertices, and of those the one closest to the meshlet's center, so meshlets are round patches with narrow normal cones
+const MeshletList &Mesh::meshlets() {
+    std::lock_guard lock(meshCacheMutex);
+    if (meshletsVersion == version && meshletsFaceCount == faces.size())
+        return cachedMeshlets;
+    meshletsVersion = version;
+    meshletsFaceCount = faces.size();
+
+    MeshletList &list = cachedMeshlets;
+    list.meshlets.clear();
+    list.faces.clear();
+    list.vertices.clear();
+
+    vector<uint32_t> faceStart(vertices.size() + 1), vertexFaces(faces.size() * 3);
+    for (auto &&face : faces)
+        for (uint32_t v : {face.v1, face.v2, face.v3})
+            faceStart[v + 1]++;
+    for (size_t v = 0; v < vertices.size(); v++)
+        faceStart[v + 1] += faceStart[v];
+    vector<uint32_t> fill(faceStart.begin(), faceStart.end() - 1);
+    for (uint32_t i = 0; i < faces.size(); i++)
+        for (uint32_t v : {faces[i].v1, faces[i].v2, faces[i].v3})
+            vertexFaces[fill[v]++] = i;
+
+    auto &&centroid = [&](const Face &face) {
+        return (vertices[face.v1].position + vertices[face.v2].position + vertices[face.v3].position) / 3;
+    };
+    vector<bool> added(faces.size());
+    vector<uint32_t> lastMeshlet(vertices.size(), UINT32_MAX); // So counting a meshlet's vertices doesn't need a search
+    vector<uint32_t> candidates;
+    size_t seed = 0;
+    while (list.faces.size() < faces.size()) {
+        uint32_t id = list.meshlets.size();
+        Meshlet meshlet{(uint32_t)list.faces.size(), (uint32_t)list.faces.size(), (uint32_t)list.vertices.size(), (uint32_t)list.vertices.size()};
+        auto &&newVertices = [&](const Face &face) {
+            return (lastMeshlet[face.v1] != id) +
+                   (lastMeshlet[face.v2] != id && face.v2 != face.v1) +
+                   (lastMeshlet[face.v3] != id && face.v3 != face.v1 && face.v3 != face.v2);
+        };
+        while (added[seed])
+            seed++;
+        uint32_t next = seed;
+        Vec3 centroidSum;
+        candidates.clear();
+        while (true) {
+            const Face &face = faces[next];
+            added[next] = true;
+            list.faces.push_back(next);
+            meshlet.faceEnd++;
+            centroidSum += centroid(face);
+            for (uint32_t v : {face.v1, face.v2, face.v3}) {
+                if (lastMeshlet[v] == id)
+                    continue;
+                lastMeshlet[v] = id;
+                list.vertices.push_back(v);
+                meshlet.vertexEnd++;
+                for (uint32_t i = faceStart[v]; i < faceStart[v + 1]; i++)
+                    if (!added[vertexFaces[i]])
+                        candidates.push_back(vertexFaces[i]);
+            }
+            if (meshlet.faceEnd - meshlet.faceBegin == Meshlet::maxFaces)
+                break;
+
+            Vec3 center = centroidSum / (meshlet.faceEnd - meshlet.faceBegin);
+            int64_t best = -1;
+            int bestNew = 4;
+            float bestDistance = INFINITY;
+            for (size_t i = 0; i < candidates.size();) {
+                if (added[candidates[i]]) {
+                    candidates[i] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                const Face &candidate = faces[candidates[i]];
+                int n = newVertices(candidate);
+                float distance = (centroid(candidate) - center).lengthSquared();
+                if (meshlet.vertexEnd - meshlet.vertexBegin + n <= Meshlet::maxVertices &&
+                    (n < bestNew || (n == bestNew && distance < bestDistance))) {
+                    best = candidates[i];
+                    bestNew = n;
+                    bestDistance = distance;
+                }
+                i++;
+            }
+            if (best < 0)
+                break;
+            next = best;
+        }
+        list.meshlets.push_back(meshlet);
+    }
+    return cachedMeshlets;
+}
+
+// -0 and 0 are equal, so they must hash the same
+static size_t hashFloat(float f) { return std::hash<float>{}(f + 0.0f); }
+
+size_t VertexWelder::Hash::operator()(const Vertex &v) const {
+    size_t h = hashFloat(v.position.x);
+    auto &&combine = [&](float f) { h ^= hashFloat(f) + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2); };
+    combine(v.position.y);
+    combine(v.position.z);
+    if (!positionOnly) {
+        combine(v.uv.x);
+        combine(v.uv.y);
+        combine(v.normal.x);
+        combine(v.normal.y);
+        combine(v.normal.z);
+    }
+    return h;
+}
+
+bool VertexWelder::Equal::operator()(const Vertex &a, const Vertex &b) const {
+    return a.position == b.position && (positionOnly || (a.uv == b.uv && a.normal == b.normal));
+}
+
+uint32_t VertexWelder::add(const Vertex &v) {
+    auto [it, inserted] = indices.try_emplace(v, vertices.size());
+    if (inserted)
+        vertices.push_back(v);
+    return it->second;
+}
+
+void weldVertices(Mesh &mesh, bool positionOnly) {
+    vector<Vertex> welded;
+    welded.reserve(mesh.vertices.size());
+    VertexWelder welder(welded, positionOnly);
+    vector<uint32_t> remap(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+        remap[i] = welder.add(mesh.vertices[i]);
+    for (auto &&face : mesh.faces) {
+        face.v1 = remap[face.v1];
+        face.v2 = remap[face.v2];
+        face.v3 = remap[face.v3];
+    }
+    mesh.vertices = std::move(welded);
+    mesh.version++;
 }
 
 shared_ptr<Mesh> loadOBJ(const std::filesystem::path &filename, shared_ptr<Material> mat, std::string name) {
@@ -33,7 +200,7 @@ shared_ptr<Mesh> loadOBJ(const std::filesystem::path &filename, shared_ptr<Mater
 
     std::vector<Vertex> vertices;
     std::vector<Face> faces;
-    uint16_t vt_n = 0;
+    uint32_t vt_n = 0;
 
     std::string line;
     while (std::getline(file, line)) {
@@ -51,7 +218,7 @@ shared_ptr<Mesh> loadOBJ(const std::filesystem::path &filename, shared_ptr<Mater
             vertices[vt_n++].uv = {u,v};
         }
         else if (prefix == "f") {
-            uint16_t a, b, c;
+            uint32_t a, b, c;
             iss >> a >> b >> c;
             a--;
             b--;
@@ -67,6 +234,7 @@ shared_ptr<Mesh> loadOBJ(const std::filesystem::path &filename, shared_ptr<Mater
     mesh->label = name;
     mesh->faces = faces;
     mesh->vertices = vertices;
+    weldVertices(*mesh, false);
     bakeMeshNormals(*mesh);
     return mesh;
 }
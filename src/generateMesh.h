@@ -1,11 +1,39 @@
 #ifndef __GENERATEMESH_H__
 #define __GENERATEMESH_H__
 
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include "object.h"
 
 void bakeMeshNormals(Mesh &mesh);
 
+// Merges identical vertices as they're added, using a hash table. With positionOnly, vertices at the same position
+// are merged even if their UVs or normals differ, which is fine for flat shaded meshes without textures.
+class VertexWelder {
+  public:
+    VertexWelder(vector<Vertex> &vertices, bool positionOnly) : vertices(vertices), positionOnly(positionOnly) {}
+    // Index of an identical vertex, or of v after adding it
+    uint32_t add(const Vertex &v);
+
+  private:
+    struct Hash {
+        bool positionOnly;
+        size_t operator()(const Vertex &v) const;
+    };
+    struct Equal {
+        bool positionOnly;
+        bool operator()(const Vertex &a, const Vertex &b) const;
+    };
+    vector<Vertex> &vertices;
+    bool positionOnly;
+    std::unordered_map<Vertex, uint32_t, Hash, Equal> indices{0, Hash{positionOnly}, Equal{positionOnly}};
+};
+
+// Merges identical vertices of the mesh and updates the faces to use them
+void weldVertices(Mesh &mesh, bool positionOnly);
+
 // Constructs a UV sphere as a Mesh pointer.
 // Parameters:
 //   stacks   - number of divisions along the latitude (vertical slices)
@@ -13,9 +41,9 @@ void bakeMeshNormals(Mesh &mesh);
 //   material - pointer to the Material to be assigned to each face
 //
 // Returns a pointer to a Mesh containing the sphere geometry.
-shared_ptr<Mesh> makeSphere(shared_ptr<Material> material, std::string name, uint16_t stacks, uint16_t sectors, bool invertU, bool invertV);
-shared_ptr<Mesh> makeCylinder(shared_ptr<Material> material, std::string name, uint16_t sectors, shared_ptr<Material> endCap, shared_ptr<Material> startCap);
-shared_ptr<Mesh> createPlane(shared_ptr<Material> material, std::string name, uint16_t subdivisionsX, uint16_t subdivisionsY);
+shared_ptr<Mesh> makeSphere(shared_ptr<Material> material, std::string name, uint32_t stacks, uint32_t sectors, bool invertU, bool invertV);
+shared_ptr<Mesh> makeCylinder(shared_ptr<Material> material, std::string name, uint32_t sectors, shared_ptr<Material> endCap, shared_ptr<Material> startCap);
+shared_ptr<Mesh> createPlane(shared_ptr<Material> material, std::string name, uint32_t subdivisionsX, uint32_t subdivisionsY);
 shared_ptr<Mesh> loadOBJ(const std::filesystem::path &filename, shared_ptr<Material> mat, std::string name);
 shared_ptr<Mesh> loadSTL(const std::filesystem::path &filename, shared_ptr<Material> mat, std::string name);
 
@@ -24,6 +52,23 @@ shared_ptr<Mesh> makeIcoSphere(std::string name, shared_ptr<Material> mat, size_
 shared_ptr<Mesh> makeDodecahedron(std::string name, shared_ptr<Material> mat, bool pentakis);
 shared_ptr<Mesh> makeTruncatedIcosahedron(std::string name, shared_ptr<Material> mat, shared_ptr<Material> matPentagons = nullptr);
 shared_ptr<Mesh> makeBall(std::string name, shared_ptr<Material> mat, shared_ptr<Material> matPentagons, size_t subdivisionSteps);
+// Quadric error edge collapse, until the mesh has at most targetFaces faces or can't be simplified further
+shared_ptr<Mesh> simplifyMesh(const Mesh &mesh, size_t targetFaces);
+// Fills mesh.lods with up to levels simplified meshes. Does nothing if they're already built for this version of the mesh.
+void buildLODs(Mesh &mesh, size_t levels);
+// Held while filling a mesh's bounds, meshlets or LODs, cameras rendering at the same time may ask for them
+extern std::mutex meshCacheMutex;
+
+// Average cache miss ratio: vertices transformed per face, with a 32 entry LRU cache of transformed vertices.
+// Between 0.5 and 3, lower is better.
+float vertexCacheMissRatio(const Mesh &mesh);
+// Reorders faces so consecutive faces share vertices (Forsyth)
+void optimizeVertexCache(Mesh &mesh);
+// Reorders vertices in the order the faces use them
+void optimizeVertexFetch(Mesh &mesh);
+// Both of the above, returns the cache miss ratio before and after
+std::pair<float, float> optimizeMesh(Mesh &mesh);
+
 shared_ptr<Mesh> makeCubeSphere(std::string name, std::array<shared_ptr<Material>, 6> mats, size_t subdivisions, bool singleTexture, bool isCube);
 
 #endif /* __GENERATEMESH_H__ */
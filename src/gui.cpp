@@ -23,7 +23,32 @@ void Timing(Metric<float> &m, const char *name) {
     ImGui::Text("%s: Last %04.1f / Mean %04.1f / Max %04.1f", name, m.last, m.average(), m.maximum);
 }
 
-void guiUpdate(shared_ptr<Window> window) {
+// The render thread measures its passes while it renders, so these are as of the last finished frame
+static FrameTimings shownTimings;
+
+static void timingsGUI() {
+    ImGui::Text("FPS: %.1f", 1000.f / shownTimings.overallTime.average());
+    Timing(shownTimings.overallTime, "Total");
+    Timing(shownTimings.windowTime, "Window");
+    Timing(shownTimings.updateTime, "Update");
+    Timing(shownTimings.skyBoxTime, "SkyBox");
+    Timing(shownTimings.renderPrepareTime, "Render prepare");
+    Timing(shownTimings.geometryTime, "Geometry");
+    Timing(shownTimings.lightingTime, "Lighting");
+    Timing(shownTimings.forwardTime, "Forward pass");
+    Timing(shownTimings.postProcessTime, "Post processing");
+}
+
+void guiUpdate(shared_ptr<Window> window, bool sceneFree) {
+    if(!sceneFree) {
+        // The render thread is using the scene, the camera and the frame, even reading them would race with it
+        ImGui::Begin("Performance");
+        timingsGUI();
+        ImGui::End();
+        return;
+    }
+    shownTimings = timing;
+
     shared_ptr<Camera> camera = window->camera;
     shared_ptr<Scene> editingScene = window->scene;
 
@@ -52,6 +77,9 @@ void guiUpdate(shared_ptr<Window> window) {
     ImGui::RadioButton("Nearest Neighbor", &editingScene->textureFilteringMode, TextureFilteringMode::NearestNeighbor);
     ImGui::RadioButton("Bilinear", &editingScene->textureFilteringMode, TextureFilteringMode::Bilinear);
     ImGui::RadioButton("Trilinear", &editingScene->textureFilteringMode, TextureFilteringMode::Trilinear);
+    ImGui::Text("Transparency:");
+    ImGui::RadioButton("Sorted", &editingScene->transparencyMode, TransparencyMode::Sorted);
+    ImGui::RadioButton("Weighted blended", &editingScene->transparencyMode, TransparencyMode::WeightedBlended);
     ImGui::SliderFloat("White point", (float *)&camera->whitePoint, 0, 5);
     ImGui::End();
 
@@ -64,17 +92,9 @@ void guiUpdate(shared_ptr<Window> window) {
         if(!res.saveToFile("render.png"))
             std::cerr << "Failed to save to render.png" << std::endl;
     }
-    ImGui::Text("FPS: %.1f", 1000.f / timing.overallTime.average());
-    Timing(timing.overallTime, "Total");
-    Timing(timing.windowTime, "Window");
-    Timing(timing.updateTime, "Update");
-    Timing(timing.skyBoxTime, "SkyBox");
-    Timing(timing.renderPrepareTime, "Render prepare");
-    Timing(timing.geometryTime, "Geometry");
-    Timing(timing.lightingTime, "Lighting");
-    Timing(timing.forwardTime, "Forward pass");
-    Timing(timing.postProcessTime, "Post processing");
+    timingsGUI();
     ImGui::Checkbox("Sync frame size to window size", &window->syncFrameSize);
+    ImGui::Checkbox("Pipelined (show each frame while the next renders)", &window->pipelined);
     if(ImGui::DragScalarN("Frame size", ImGuiDataType_U32, &window->frame->size, 2)) {
         if(window->syncFrameSize)
             window->changeSize(window->frame->size);
@@ -83,6 +103,18 @@ void guiUpdate(shared_ptr<Window> window) {
     }
     if(ImGui::Checkbox("Use Deferred rendering", &window->frame->deferred))
         window->frame->changeSize(window->frame->size, window->frame->deferred);
+    if(!window->frame->deferred)
+        ImGui::Checkbox("Depth pre-pass", &window->frame->depthPrePass);
+    else {
+        ImGui::Text("G-buffer layout");
+        GBufferLayout &layout = window->frame->gBufferLayout;
+        if(ImGui::RadioButton("Fragments", &layout, GBufferLayout::Fragments) |
+           ImGui::RadioButton("Packed", &layout, GBufferLayout::Packed) |
+           ImGui::RadioButton("Visibility buffer", &layout, GBufferLayout::Visibility))
+            window->frame->changeSize(window->frame->size, window->frame->deferred);
+        if(ImGui::DragScalar("Transparency layers (0 = unlimited)", ImGuiDataType_U32, &window->frame->transparencyLayers))
+            window->frame->changeSize(window->frame->size, window->frame->deferred);
+    }
     ImGui::End();
 
     if(ImGui::Begin("Objects")) {
@@ -201,11 +233,12 @@ void guiUpdate(shared_ptr<Window> window) {
                     ImGui::Text("%lu vertices, %lu faces", mesh->vertices.size(), mesh->faces.size());
                     ImGui::Checkbox("Flat shading", &mesh->flatShading);
                     if(ImGui::TreeNode("Vertices")) {
-                        for (uint16_t j = 0; j < mesh->vertices.size(); j++)
+                        for (size_t j = 0; j < mesh->vertices.size(); j++)
                         {
                             ImGui::PushID(j);
                             Vertex &v = mesh->vertices[j];
-                            ImGui::DragFloat3("Position", &v.position.x, 0.2f);
+                            if(ImGui::DragFloat3("Position", &v.position.x, 0.2f))
+                                mesh->version++;
                             ImGui::DragFloat2("UV", &v.uv.x, 0.2f);
                             ImGui::PopID();
                         }
@@ -218,10 +251,10 @@ void guiUpdate(shared_ptr<Window> window) {
                             .emissive = std::make_shared<SolidTexture<Color>>(Color{1,1,0,1})
                         }, (std::string)"Highlight", MaterialFlags{.doubleSided = true});
 
-                        for (uint16_t j = 0; j < mesh->faces.size(); j++) {
+                        for (size_t j = 0; j < mesh->faces.size(); j++) {
                             ImGui::PushID(j);
                             Face &f = mesh->faces[j];
-                            uint16_t step = 1;
+                            uint32_t step = 1;
                             std::string label = std::to_string(j);
                             if(findFaceMode) {
                                 ImGui::Text("%s", (label+"               ").c_str());
@@ -234,7 +267,8 @@ void guiUpdate(shared_ptr<Window> window) {
                                     f.material = highlightMat;
                                 }
                             } else {
-                                ImGui::InputScalarN(label.c_str(), ImGuiDataType_U16, &f.v1, 3, &step);
+                                if(ImGui::InputScalarN(label.c_str(), ImGuiDataType_U32, &f.v1, 3, &step))
+                                    mesh->version++;
                                 if(ImGui::RadioButton("Highlight", &f == highlightedFace)) {
                                     if(highlightedFace) {
                                         highlightedFace->material = highlightedMaterial;
@@ -28,5 +28,6 @@ extern vector<std::weak_ptr<Material>> materials;
 extern vector<std::weak_ptr<Volume>> volumes;
 extern vector<std::weak_ptr<Mesh>> meshes;
 
-void guiUpdate(shared_ptr<Window> window);
+// Only shows the timings unless sceneFree, while a frame renders the render thread owns the scene
+void guiUpdate(shared_ptr<Window> window, bool sceneFree);
 #endif /* __GUI_H__ */
@@ -38,9 +38,10 @@ std::pair<Color, Vec3> SpotLight::sample(Vec3 pos, Scene &scene) {
     float dist = std::sqrt(distSq);
     Vec3 distNormalized = diff / dist;
     float cos = distNormalized.dot(direction);
-    if(cos < spreadOuterCos)
+    float falloff = rangeFalloff(distSq, range);
+    if(cos < spreadOuterCos || falloff == 0)
         return {{0, 0, 0, 0}, {0, 0, 0}};
-    float strength = smoothstep(spreadOuterCos, spreadInnerCos, cos);
+    float strength = smoothstep(spreadOuterCos, spreadInnerCos, cos) * falloff;
 
 
     if(shadowMap) {
@@ -86,6 +87,11 @@ void Light::GUI() {
     ImGui::ColorEdit4("Color", (float*)&color, ImGuiColorEditFlags_Float|ImGuiColorEditFlags_HDR);
 }
 
+void PointLight::GUI() {
+    Light::GUI();
+    ImGui::DragFloat("Range", &range, 0.1, 0, INFINITY);
+}
+
 void SpotLight::setupShadowMap(Vector2u size) {
     shadowMap = new Camera();
     shadowMap->init(obj);
@@ -97,6 +103,7 @@ void SpotLight::GUI() {
     Light::GUI();
     ImGui::SliderFloat("Spread inner", &spreadInner, 0, M_PI_2);
     ImGui::SliderFloat("Spread outer", &spreadOuter, 0, M_PI_2);
+    ImGui::DragFloat("Range", &range, 0.1, 0, INFINITY);
     if (shadowMap && ImGui::TreeNode("Shadow map")) {
         if(ImGui::DragScalarN("Resolution", ImGuiDataType_U32, &shadowMap->frame->size.x, 2))
             shadowMap->frame->changeSize(shadowMap->frame->size, true);
@@ -5,6 +5,15 @@
 #include "object.h"
 #include "camera.h"
 
+// Windows the inverse square falloff so it reaches 0 at range, instead of cutting the light off with a visible edge
+inline float rangeFalloff(float distSq, float range) {
+    if(range <= 0)
+        return 1;
+    float x = distSq * distSq / (range * range * range * range);
+    float window = std::max(1 - x, 0.0f);
+    return window * window;
+}
+
 class Light : public Component {
   public:
     Color color;
@@ -13,6 +22,8 @@ class Light : public Component {
     virtual ~Light();
     virtual std::pair<Color, Vec3> sample(Vec3 pos, Scene &scene) = 0;
     virtual void update();
+    // Distance past which the light adds nothing, so shading only goes through it nearby, see Camera::forEachLight
+    virtual float reach() { return INFINITY; }
 
     void GUI();
   private:
@@ -21,6 +32,8 @@ class Light : public Component {
 
 class PointLight : public Light {
   public:
+    float range = 0; // Fades out completely at this distance, 0 for no limit
+
     PointLight(Color color)
         : Light(color) {}
 
@@ -29,8 +42,10 @@ class PointLight : public Light {
     std::pair<Color, Vec3> sample(Vec3 pos, Scene &scene) {
         Vec3 dist = pos - obj->globalPosition;
         float distSq = dist.lengthSquared();
-        return {color * (color.a / distSq), dist / std::sqrt(distSq)};
+        return {color * (color.a * rangeFalloff(distSq, range) / distSq), dist / std::sqrt(distSq)};
     }
+    float reach() { return range > 0 ? range : INFINITY; }
+    void GUI();
 };
 
 class DirectionalLight : public Light {
@@ -55,6 +70,7 @@ class SpotLight : public Light {
   public:
     float spreadInner, spreadOuter;
     float spreadInnerCos, spreadOuterCos;
+    float range = 0; // Fades out completely at this distance, 0 for no limit
     Camera *shadowMap = nullptr;
 
     SpotLight(Color color, float spreadInner, float spreadOuter) 
@@ -63,6 +79,7 @@ class SpotLight : public Light {
     std::string name() { return "Spotlight"; }
 
     std::pair<Color, Vec3> sample(Vec3 pos, Scene &scene);
+    float reach() { return range > 0 ? range : INFINITY; }
 
     void update() {
         Light::update();
@@ -72,10 +89,8 @@ class SpotLight : public Light {
             std::swap(spreadInnerCos, spreadOuterCos);
         direction = Vec3{0, 0, 1} * obj->transformRotation;
         
-        if(shadowMap) {
+        if(shadowMap) // Rendered with the frame, by FrameGraph::addScene
             shadowMap->fov = std::max(spreadOuter, spreadInner) * (360.0f / M_PIf);
-            shadowMap->render();
-        }
     }
 
     void setupShadowMap(Vector2u size);
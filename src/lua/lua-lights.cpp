@@ -19,6 +19,7 @@ void luaLights() {
             return std::make_shared<PointLight>( color);
         },
         "color", &PointLight::color,
+        "range", &PointLight::range,
         "as_component", [](std::shared_ptr<PointLight>& l) -> std::shared_ptr<Component> { return l; }
     );
 
@@ -37,6 +38,7 @@ void luaLights() {
         "color", &SpotLight::color,
         "spread_inner", &SpotLight::spreadInner,
         "spread_outer", &SpotLight::spreadOuter,
+        "range", &SpotLight::range,
         "as_component", [](std::shared_ptr<SpotLight>& l) -> std::shared_ptr<Component> { return l; }
     );
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "../object.h"
 #include "../generateMesh.h"
 #include "../gui.h"
+#include <iostream>
 
 #ifdef __GNUC__
 #pragma GCC diagnostic ignored "-Warray-bounds"
@@ -10,6 +11,11 @@
 #pragma clang diagnostic ignored "-Warray-bounds"
 #endif
 
+static void optimize(Mesh &mesh) {
+    auto [before, after] = optimizeMesh(mesh);
+    std::cout << "Optimized mesh " << mesh.label << ", cache miss ratio " << before << " -> " << after << std::endl;
+}
+
 void luaMesh() {
         auto VertexConstructor = [](sol::table t) {
         Vertex v{};
@@ -82,9 +88,9 @@ void luaMesh() {
 
     auto FaceConstructor = [](sol::table t) {
         Face f{};
-        f.v1 = t.get_or("v1", static_cast<uint16_t>(t.get_or(1, 0)));
-        f.v2 = t.get_or("v2", static_cast<uint16_t>(t.get_or(2, 0)));
-        f.v3 = t.get_or("v3", static_cast<uint16_t>(t.get_or(3, 0)));
+        f.v1 = t.get_or("v1", static_cast<uint32_t>(t.get_or(1, 0)));
+        f.v2 = t.get_or("v2", static_cast<uint32_t>(t.get_or(2, 0)));
+        f.v3 = t.get_or("v3", static_cast<uint32_t>(t.get_or(3, 0)));
         f.material = t.get_or("material", nullptr);
         return f;
     };
@@ -95,7 +101,7 @@ void luaMesh() {
         "v3", &Face::v3,
         "material", &Face::material,
         sol::meta_function::construct, sol::overload(
-            [](uint16_t a, uint16_t b, uint16_t c, shared_ptr<Material> mat) {
+            [](uint32_t a, uint32_t b, uint32_t c, shared_ptr<Material> mat) {
                 Face f{};
                 f.v1 = a; f.v2 = b; f.v3 = c; f.material = mat;
                 return f;
@@ -144,9 +150,9 @@ void luaMesh() {
                         } else if (elem.get_type() == sol::type::table) {
                             sol::table ft = elem;
                             Face f;
-                            f.v1 = static_cast<uint16_t>(ft.get_or(1, 0));
-                            f.v2 = static_cast<uint16_t>(ft.get_or(2, 0));
-                            f.v3 = static_cast<uint16_t>(ft.get_or(3, 0));
+                            f.v1 = static_cast<uint32_t>(ft.get_or(1, 0));
+                            f.v2 = static_cast<uint32_t>(ft.get_or(2, 0));
+                            f.v3 = static_cast<uint32_t>(ft.get_or(3, 0));
                             f.material = ft.get_or<shared_ptr<Material>>(4, nullptr);
                             mesh.faces.push_back(f);
                         }
@@ -156,6 +162,8 @@ void luaMesh() {
                 if(t.get_or("auto_normals", false)) {
                     bakeMeshNormals(mesh);
                 }
+                if (t.get_or("optimize", false))
+                    optimize(mesh);
 
                 auto meshPtr = std::make_shared<Mesh>(std::move(mesh));
                 meshes.emplace_back(meshPtr);
@@ -168,8 +176,16 @@ void luaMesh() {
         // "vertices", &Mesh::vertices, // vector<Vertex> (sol can handle vectors if Vertex usertype exists) // no it cant
         // "faces", &Mesh::faces,       // vector<Face>
         "flatShading", &Mesh::flatShading,
-        "vertex_at", [](shared_ptr<Mesh> &mesh, size_t i) {return &mesh->vertices[i-1];},
-        "face_at", [](shared_ptr<Mesh> &mesh, size_t i) {return &mesh->faces[i-1];}
+        "vertex_at", [](shared_ptr<Mesh> &mesh, size_t i) {
+            mesh->version++; // The vertex may be changed through the returned reference
+            return &mesh->vertices[i-1];
+        },
+        "face_at", [](shared_ptr<Mesh> &mesh, size_t i) {
+            mesh->version++; // Same as vertex_at, meshlets and LODs depend on the faces
+            return &mesh->faces[i-1];
+        },
+        "cache_miss_ratio", [](shared_ptr<Mesh> &mesh) { return vertexCacheMissRatio(*mesh); },
+        "optimize", [](shared_ptr<Mesh> &mesh) { optimize(*mesh); }
     );
 
     Lua.new_usertype<MeshComponent>("MeshComponent",
@@ -178,6 +194,14 @@ void luaMesh() {
             return std::make_shared<MeshComponent>(mesh);
         },
         "mesh", &MeshComponent::mesh,
+        "lod_thresholds", sol::property(
+            [](MeshComponent &self) { return sol::as_table(self.lodThresholds); },
+            [](MeshComponent &self, sol::table t) {
+                self.lodThresholds.clear();
+                for (size_t i = 1; i <= t.size(); i++)
+                    self.lodThresholds.push_back(t.get<float>(i));
+            }
+        ),
         "as_component", [](shared_ptr<MeshComponent> &c)-> shared_ptr<Component> { return c; }
     );
 
@@ -278,6 +302,8 @@ void luaMesh() {
         }
         else mesh = std::make_shared<Mesh>();
         mesh->flatShading = t.get_or("flat_shading", mesh->flatShading);
+        if (t.get_or("optimize", false))
+            optimize(*mesh);
         meshes.emplace_back(mesh);
         return mesh;
     };
@@ -36,9 +36,11 @@ void luaObject() {
         }
     );
 
+    // The render list and BVH of the scene keep raw pointers to the components, so these lists are only changed
+    // through the add_ functions, which invalidate them
     Lua.new_usertype<Object>("Object",
-        "children", &Object::children,
-        "components", &Object::components,
+        "children", sol::readonly(&Object::children),
+        "components", sol::readonly(&Object::components),
         "name", &Object::name,
         "position", &Object::position,
         "rotation", &Object::rotation,
@@ -75,6 +77,7 @@ void luaObject() {
         ),
         "add_child", [](Object& obj, shared_ptr<Object> child) {
             if(auto scene = child->scene.lock()) {
+                scene->invalidateRenderList();
                 if(child->parent) { // it already has a parent, gotta remove it
                     vector<shared_ptr<Object>> &vec = child->parent->children;
                     vec.erase(std::remove(vec.begin(), vec.end(), child), vec.end());
@@ -88,10 +91,14 @@ void luaObject() {
                 child->setScene(obj.scene);
             child->parent = &obj;
             child->update();
+            if(auto scene = obj.scene.lock())
+                scene->invalidateRenderList();
         },
         "add_component", [](Object& obj, shared_ptr<Component> component) {
             component->init(&obj);
             obj.components.push_back(std::move(component));
+            if(auto scene = obj.scene.lock())
+                scene->invalidateRenderList();
         },
         "transform", [](Object &obj, Vec3 vec) {
             return vec * obj.transform;
@@ -16,12 +16,13 @@ void luaScene() {
         },
         "name", &Scene::name,
         "sky_box", &Scene::skyBox,
-        "objects", &Scene::objects,
+        "objects", sol::readonly(&Scene::objects), // Changed only through add_object(s), see luaObject
         "add_object", [](Scene& scene, shared_ptr<Object> child) {
             child->setScene(scene.shared_from_this());
             child->parent = nullptr;
             child->update();
             scene.objects.push_back(std::move(child));
+            scene.invalidateRenderList();
         },
         "add_objects", [](Scene &scene, sol::table children) {
             for (auto& kv : children.as<sol::table>()) {
@@ -31,6 +32,7 @@ void luaScene() {
                 child->update();
                 scene.objects.push_back(child);
             }
+            scene.invalidateRenderList();
         },
         "back_face_culling", &Scene::backFaceCulling,
         "ambient_light", &Scene::ambientLight,
@@ -64,6 +66,25 @@ void luaScene() {
                 else if(mode == "trilinear")
                     s.textureFilteringMode = Trilinear;
             }
+        ),
+        "transparency_mode", sol::property(
+            [](Scene &s) {
+                using enum TransparencyMode;
+                switch (s.transparencyMode) {
+                case WeightedBlended:
+                    return "weighted_blended";
+                case Sorted:
+                default:
+                    return "sorted";
+                }
+            },
+            [](Scene &s, std::string mode) {
+                using enum TransparencyMode;
+                if(mode == "sorted")
+                    s.transparencyMode = Sorted;
+                else if(mode == "weighted_blended")
+                    s.transparencyMode = WeightedBlended;
+            }
         )
     );
 }
\ No newline at end of file
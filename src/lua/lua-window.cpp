@@ -8,6 +8,17 @@
 #pragma clang diagnostic ignored "-Warray-bounds"
 #endif
 
+GBufferLayout parseGBufferLayout(std::string name) {
+    using enum GBufferLayout;
+    if(name == "fragments")
+        return Fragments;
+    else if(name == "packed")
+        return Packed;
+    else if(name == "visibility")
+        return Visibility;
+    throw std::runtime_error("Unknown G-buffer layout: " + name);
+}
+
 void luaWindow() {
         Lua.new_usertype<Window>("Window",
         sol::meta_function::construct, [](sol::table props) {
@@ -28,6 +39,7 @@ void luaWindow() {
                 .name = props["name"],
                 .size = size,
                 .syncFrameSize = props.get_or("sync_frame_size", true),
+                .pipelined = props.get_or("pipelined", false),
                 .gui = props.get_or<std::function<void()>>("on_gui", [](){}),
                 .onEvent = props["on_event"].valid() ? (std::function<void(std::optional<sf::Event>)>)(
                     [onEvent](std::optional<sf::Event> event) {
@@ -85,8 +97,14 @@ void luaWindow() {
                 throw std::runtime_error("One of window camera/scene was specified but not the other");
             if(window->toolWindowFor && !window->hasGui)
                 throw std::runtime_error("has_gui has to be true when tool_window_for is set");
-            if(window->frame)
+            if(window->frame) {
+                window->frame->depthPrePass = props.get_or("depth_pre_pass", false);
+                window->frame->gBufferLayout = parseGBufferLayout(props.get_or<std::string>("g_buffer_layout", "fragments"));
+                window->frame->transparencyLayers = props.get_or("transparency_layers", 0u);
+                if(window->frame->gBufferLayout != GBufferLayout::Fragments || window->frame->transparencyLayers)
+                    window->frame->changeSize(size, window->frame->deferred); // Replace the G-buffer
                 window->camera->frame = window->frame.get();
+            }
             if(initComplete)
                 window->init();
             windows.push_back(window);
@@ -159,6 +177,7 @@ void luaWindow() {
         "scene", sol::readonly(&Window::scene),
         "quit_when_closed", &Window::quitWhenClosed,
         "sync_frame_size", &Window::syncFrameSize,
+        "pipelined", &Window::pipelined,
         "set_camera", [](shared_ptr<Window> self, shared_ptr<Scene> scene, shared_ptr<Camera> camera) {
             if(!scene)
                 throw std::runtime_error("Scene is nil");
@@ -194,6 +213,55 @@ void luaWindow() {
                     throw std::runtime_error("Cannot set deferred for a camera-less window, use set_camera first.");
                 self.frame->changeSize(self.frame->size, value);
             }
+        ),
+        "depth_pre_pass", sol::property(
+            [](Window& self)-> sol::object { 
+                if(self.frame)
+                    return sol::make_object(Lua, self.frame->depthPrePass);
+                else
+                    return sol::nil;
+            },
+            [](Window& self, bool value) {
+                if(!self.frame)
+                    throw std::runtime_error("Cannot set depth_pre_pass for a camera-less window, use set_camera first.");
+                self.frame->depthPrePass = value;
+            }
+        ),
+        "g_buffer_layout", sol::property(
+            [](Window& self)-> sol::object { 
+                if(!self.frame)
+                    return sol::nil;
+                using enum GBufferLayout;
+                switch (self.frame->gBufferLayout) {
+                case Packed:
+                    return sol::make_object(Lua, "packed");
+                case Visibility:
+                    return sol::make_object(Lua, "visibility");
+                case Fragments:
+                default:
+                    return sol::make_object(Lua, "fragments");
+                }
+            },
+            [](Window& self, std::string value) {
+                if(!self.frame)
+                    throw std::runtime_error("Cannot set g_buffer_layout for a camera-less window, use set_camera first.");
+                self.frame->gBufferLayout = parseGBufferLayout(value);
+                self.frame->changeSize(self.frame->size, self.frame->deferred);
+            }
+        ),
+        "transparency_layers", sol::property(
+            [](Window& self)-> sol::object { 
+                if(self.frame)
+                    return sol::make_object(Lua, self.frame->transparencyLayers);
+                else
+                    return sol::nil;
+            },
+            [](Window& self, uint value) {
+                if(!self.frame)
+                    throw std::runtime_error("Cannot set transparency_layers for a camera-less window, use set_camera first.");
+                self.frame->transparencyLayers = value;
+                self.frame->changeSize(self.frame->size, self.frame->deferred);
+            }
         )
     );
 }
\ No newline at end of file
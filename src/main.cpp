@@ -2,26 +2,46 @@
 #include "gui.h"
 #include "multithreading.h"
 #include "main.h"
+#include "renderThread.h"
 #include "lua/lua.h"
 #include <SFML/Graphics.hpp>
 #include <SFML/System/Vector2.hpp>
+#include <iostream>
 #include <memory>
 #include <string>
 
 std::vector<std::shared_ptr<Window>> windows;
 
+// Handling of the events that may change the scene, so only while the render thread isn't rendering
+static void handleEvent(Window &window, const sf::Event &event) {
+    if(window.onEvent) {
+        window.onEvent(event);
+    }
+    if (const auto* resized = event.getIf<sf::Event::Resized>()) {
+        window.changeSize(resized->size);
+    }
+    if (const auto* pressed = event.getIf<sf::Event::MouseButtonPressed>()) {
+        if(auto frame = window.frame) {
+            if(pressed->button == sf::Mouse::Button::Left && guiMaterialAssignMode != GuiMaterialAssignMode::None) {
+                Face *face = window.camera->pick(pressed->position.x, pressed->position.y);
+                if(face)
+                    face->material = guiSelectedMaterial;
+            }
+        }
+    }
+}
+
 int main(int argc, char** argv) {
     lua(argc > 1 ? argv[1] : "assets/scene.lua");
 
-    sf::Clock deltaClock;
+    sf::Clock deltaClock; // Between iterations of the window loop
+    sf::Clock frameClock; // Between rendered frames, the scenes update once per frame
 
     for (auto &&window : windows) {
         window->init();
     }
 
     while (windows.size() > 0) {
-        timing.deltaTime = deltaClock.getElapsedTime().asSeconds();
-        timing.totalTime += timing.deltaTime;
         timing.clock.restart();
 
         windows.erase(
@@ -35,9 +55,11 @@ int main(int argc, char** argv) {
             scenes.end()
         );
 
+        // While a frame renders the render thread owns the scenes, anything that may change them waits until it's done.
+        // The windows keep showing the last finished frame meanwhile.
+        bool sceneFree = !renderThread.busy();
+
         for (auto && window : windows) {
-            if(window->scene)
-                window->scene->shouldUpdate = true;
             while (const std::optional event = window->window.pollEvent()) {
                 if (event->is<sf::Event::Closed>()) {
                     window->window.close();
@@ -48,66 +70,79 @@ int main(int argc, char** argv) {
                 if(window->hasGui) {
                     ImGui::SFML::ProcessEvent(window->window, *event);
                 }
-                if(window->onEvent) {
-                    window->onEvent(event);
-                }
-                if (const auto* resized = event->getIf<sf::Event::Resized>()) {
-                    window->changeSize(resized->size);
-                }
-                if (const auto* pressed = event->getIf<sf::Event::MouseButtonPressed>()) {
-                    if(auto frame = window->frame) {
-                        if(pressed->button == sf::Mouse::Button::Left && guiMaterialAssignMode != GuiMaterialAssignMode::None && frame->deferred) {
-                            // Find face
-                            uint index = pressed->position.x + frame->size.x * pressed->position.y;
-                            if(frame->zBuffer[index] != INFINITY)
-                                frame->gBuffer[index].face->material = guiSelectedMaterial;
-                        }
-                    }
-                }
+                window->pendingEvents.push_back(*event);
             }
         }
 
-        for (auto &&s : scenes) {
-            auto scene = s.lock();
-            if(scene->alwaysUpdate || scene->shouldUpdate) {
-                for (auto &&obj : scene->objects)
-                    obj->update();
-                scene->shouldUpdate = false;
+        if(sceneFree) {
+            timing.deltaTime = frameClock.restart().asSeconds();
+            timing.totalTime += timing.deltaTime;
+            timing.overallTime.push(timing.deltaTime * 1000.0f);
+
+            for (auto &&window : windows) {
+                if(window->scene)
+                    window->scene->shouldUpdate = true;
+                for (auto &&event : window->pendingEvents)
+                    handleEvent(*window, event);
+                window->pendingEvents.clear();
+            }
+
+            for (auto &&s : scenes) {
+                auto scene = s.lock();
+                if(scene->alwaysUpdate || scene->shouldUpdate) {
+                    for (auto &&obj : scene->objects)
+                        obj->update();
+                    scene->shouldUpdate = false;
+                }
+            }
+            luaOnFrame();
+            timing.updateTime.push(timing.clock);
+
+            for (auto &&window : windows) {
+                if(!window->renderedImageReady)
+                    continue;
+                window->renderedImageReady = false;
+                const sf::Image &image = window->renderedImage;
+                if(window->texture.getSize() != image.getSize() && !window->texture.resize(image.getSize()))
+                    std::cerr << "Failed to resize the texture of window " << window->name << std::endl;
+                window->texture.update(image);
+                window->texture.setSmooth(true);
             }
         }
-        luaOnFrame();
-        timing.updateTime.push(timing.clock);
-        timing.overallTime.push(deltaClock);
 
         for (auto &&window : windows) {
             currentWindow = window;
+            timing.clock.restart();
             window->window.clear();
-            if(window->frame) {
-                if(window->scene->shouldUpdate) // Oh no didn't update
-                    continue;
-                if(timing.render)
-                    window->camera->render();
-
-                timing.clock.restart();
-
-                sf::Texture tex(window->camera->getRenderedFrame(window->scene->renderMode));
-                tex.setSmooth(true);
-                sf::Sprite spr(tex);
+            if(window->frame && window->texture.getSize().x) {
+                sf::Sprite spr(window->texture);
                 window->window.draw(spr);
             }
             if(window->hasGui) {
                 ImGui::SFML::Update(window->window, deltaClock.getElapsedTime());
+                // While a frame renders, the GUI would read what the render thread writes, and Lua's could change the scene.
+                // Only the timings are shown until it's done.
                 if(window->toolWindowFor)
-                    guiUpdate(window->toolWindowFor);
-                if(window->gui)
+                    guiUpdate(window->toolWindowFor, sceneFree);
+                if(window->gui && sceneFree)
                     window->gui();
                 ImGui::SFML::Render(window->window);
             }
             window->window.display();
             timing.postProcessTime.push(timing.clock);
         }
+        deltaClock.restart();
 
+        if(sceneFree && timing.render) {
+            std::vector<shared_ptr<Window>> rendered;
+            for (auto &&window : windows)
+                if(window->frame && !window->scene->shouldUpdate) // Skip the ones whose scene didn't update
+                    rendered.push_back(window);
+            if(!rendered.empty())
+                renderThread.start(std::move(rendered));
+        }
     }
+    renderThread.stop();
     luaDestroy();
     ImGui::SFML::Shutdown();
     shutdownThreads();
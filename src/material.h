@@ -48,6 +48,8 @@ public:
         : name(name), flags(flags), needsTBN(needsTBN), volumeBack(back), volumeFront(front) {}
     virtual Color shade(Fragment &f, Color previous, Scene &scene) = 0;
     virtual Color getBaseColor(Vector2f uv, Vector2f dUVdx, Vector2f dUVdy) = 0;
+    // How much of what's behind a transparent fragment shows through it, per channel. Only used for weighted blended transparency.
+    virtual Color transmittance(Fragment &f) { return {0, 0, 0, 0}; }
     virtual void GUI();
 };
 
@@ -2,6 +2,9 @@
 #include <math.h>
 #include <vector>
 #include "matrix.h"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 
 
 
@@ -45,7 +48,14 @@ void matScalarDiv(float *a, float scalar, float *out, int rows, int cols) {
 }
 
 void matMul(const float *a, const float *b, float *out, int aRows, int aCols, int bCols) {
-    std::vector<float> temp(aRows * bCols);  // Temporary buffer
+    // out may alias a or b, so the result is built in a temporary buffer. It's on the stack unless the result is big.
+    float small[16];
+    std::vector<float> large;
+    float *temp = small;
+    if (aRows * bCols > 16) {
+        large.resize(aRows * bCols);
+        temp = large.data();
+    }
 
     for (int i = 0; i < aRows; ++i) {
         for (int j = 0; j < bCols; ++j) {
@@ -57,7 +67,7 @@ void matMul(const float *a, const float *b, float *out, int aRows, int aCols, in
     }
 
     // Copy result back to out
-    std::copy(temp.begin(), temp.end(), out);
+    std::copy(temp, temp + aRows * bCols, out);
 }
 
 void makeIdentityMatrix(float *out, int size) {
@@ -66,18 +76,74 @@ void makeIdentityMatrix(float *out, int size) {
             out[i + size * j] = i == j ? 1 : 0;
 }
 
-TransformMatrix operator* (const TransformMatrix &a, const TransformMatrix &b) {
-    TransformMatrix res;
-    matMul(a.data(), b.data(), res.data(), 4, 4, 4);
-    return res;
+// Output component i is x * m[c] + y * m[4 + c] + z * m[8 + c] + t, with c = columns[i] and t = translation[i].
+// Operations are done in the same order as the scalar kernels, without FMA, so results match them exactly.
+static void transformStream(
+    const Vec3Stream &in, const TransformMatrix &m, Vec3Stream &out, std::array<int, 3> columns, bool translate,
+    size_t begin, size_t end
+) {
+    size_t n = end - begin;
+    out.resize(n);
+    const float *x = in.x.data() + begin, *y = in.y.data() + begin, *z = in.z.data() + begin;
+    float *outs[3] = {out.x.data(), out.y.data(), out.z.data()};
+    float mx[3], my[3], mz[3], t[3];
+    for (int i = 0; i < 3; i++) {
+        mx[i] = m[columns[i]];
+        my[i] = m[4 + columns[i]];
+        mz[i] = m[8 + columns[i]];
+        t[i] = translate ? m[12 + columns[i]] : 0;
+    }
+
+    size_t j = 0;
+#if defined(__AVX__)
+    for (; j + 8 <= n; j += 8) {
+        __m256 vx = _mm256_loadu_ps(x + j), vy = _mm256_loadu_ps(y + j), vz = _mm256_loadu_ps(z + j);
+        __m256 r[3];
+        for (int i = 0; i < 3; i++) { // All loads happen before the stores, so out can be in
+            r[i] = _mm256_add_ps(_mm256_mul_ps(vx, _mm256_set1_ps(mx[i])), _mm256_mul_ps(vy, _mm256_set1_ps(my[i])));
+            r[i] = _mm256_add_ps(r[i], _mm256_mul_ps(vz, _mm256_set1_ps(mz[i])));
+            r[i] = _mm256_add_ps(r[i], _mm256_set1_ps(t[i]));
+        }
+        for (int i = 0; i < 3; i++)
+            _mm256_storeu_ps(outs[i] + j, r[i]);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    for (; j + 4 <= n; j += 4) {
+        __m128 vx = _mm_loadu_ps(x + j), vy = _mm_loadu_ps(y + j), vz = _mm_loadu_ps(z + j);
+        __m128 r[3];
+        for (int i = 0; i < 3; i++) {
+            r[i] = _mm_add_ps(_mm_mul_ps(vx, _mm_set1_ps(mx[i])), _mm_mul_ps(vy, _mm_set1_ps(my[i])));
+            r[i] = _mm_add_ps(r[i], _mm_mul_ps(vz, _mm_set1_ps(mz[i])));
+            r[i] = _mm_add_ps(r[i], _mm_set1_ps(t[i]));
+        }
+        for (int i = 0; i < 3; i++)
+            _mm_storeu_ps(outs[i] + j, r[i]);
+    }
+#endif
+    for (; j < n; j++) {
+        float vx = x[j], vy = y[j], vz = z[j];
+        float r[3];
+        for (int i = 0; i < 3; i++)
+            r[i] = vx * mx[i] + vy * my[i] + vz * mz[i] + t[i];
+        for (int i = 0; i < 3; i++)
+            outs[i][j] = r[i];
+    }
 }
 
-Vec3 operator* (const Vec3 &a, const TransformMatrix &m) {
-    return {
-        a.x * m[0] + a.y * m[4] + a.z * m[8]  + m[12],
-        a.x * m[1] + a.y * m[5] + a.z * m[9]  + m[13],
-        a.x * m[2] + a.y * m[6] + a.z * m[10] + m[14]
-    };
+void transformPoints(const Vec3Stream &in, const TransformMatrix &m, Vec3Stream &out) {
+    transformStream(in, m, out, {0, 1, 2}, true, 0, in.size());
+}
+
+void transformDirections(const Vec3Stream &in, const TransformMatrix &m, Vec3Stream &out) {
+    transformStream(in, m, out, {0, 1, 2}, false, 0, in.size());
+}
+
+void transformProjective(const Vec3Stream &in, const TransformMatrix &m, Vec3Stream &out) {
+    transformStream(in, m, out, {0, 1, 3}, true, 0, in.size());
+}
+
+void transformProjective(const Vec3Stream &in, const TransformMatrix &m, Vec3Stream &out, size_t begin, size_t end) {
+    transformStream(in, m, out, {0, 1, 3}, true, begin, end);
 }
 
 TransformMatrix makeRotationMatrix(Vec3 R) {
@@ -103,7 +169,7 @@ TransformMatrix makeRotationMatrix(Vec3 R) {
     };
 }
 
-TransformMatrix transposeMatrix(TransformMatrix &mat) {
+TransformMatrix transposeMatrix(const TransformMatrix &mat) {
     TransformMatrix transposed;
     for (int i = 0; i < 4; ++i) {
         for (int j = 0; j < 4; ++j) {
@@ -113,7 +179,7 @@ TransformMatrix transposeMatrix(TransformMatrix &mat) {
     return transposed;
 }
 
-bool inverseMatrix(TransformMatrix &mat, TransformMatrix &out) {
+bool inverseMatrix(const TransformMatrix &mat, TransformMatrix &out) {
     float det = mat[0] * (mat[5] * mat[10] - mat[6] * mat[9]) -
                 mat[1] * (mat[4] * mat[10] - mat[6] * mat[8]) +
                 mat[2] * (mat[4] * mat[9] - mat[5] * mat[8]);
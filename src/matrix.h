@@ -23,10 +23,59 @@ void matScalarDiv(float *a, float scalar, float *out, int rows, int cols);
 void matMul(const float *a, const float *b, float *out, int aRows, int aCols, int bCols);
 void makeIdentityMatrix(float *out, int size);
 
-TransformMatrix operator*(const TransformMatrix &a, const TransformMatrix &b);
-Vec3 operator* (const Vec3 &a, const TransformMatrix &b);
+// Fixed size 4x4 kernels, these run for every object and vertex so they avoid matMul's generality
+constexpr TransformMatrix operator*(const TransformMatrix &a, const TransformMatrix &b) {
+    TransformMatrix res{};
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++) {
+            float sum = 0;
+            for (int k = 0; k < 4; k++)
+                sum += a[i * 4 + k] * b[k * 4 + j];
+            res[i * 4 + j] = sum;
+        }
+    return res;
+}
+
+// Transforms a point (w = 1), row vector convention
+constexpr Vec3 operator*(const Vec3 &a, const TransformMatrix &m) {
+    return {
+        a.x * m[0] + a.y * m[4] + a.z * m[8]  + m[12],
+        a.x * m[1] + a.y * m[5] + a.z * m[9]  + m[13],
+        a.x * m[2] + a.y * m[6] + a.z * m[10] + m[14]
+    };
+}
+
+// Transforms a point (w = 1) and returns x, y and w of the result, for projection matrices
+constexpr Vec3 transformProjective(const Vec3 &a, const TransformMatrix &m) {
+    return {
+        a.x * m[0] + a.y * m[4] + a.z * m[8]  + m[12],
+        a.x * m[1] + a.y * m[5] + a.z * m[9]  + m[13],
+        a.x * m[3] + a.y * m[7] + a.z * m[11] + m[15]
+    };
+}
+
+// Structure of arrays vector stream, so that many vectors can be transformed at once with SIMD
+struct Vec3Stream {
+    std::vector<float> x, y, z;
+
+    size_t size() const { return x.size(); }
+    void resize(size_t n) { x.resize(n); y.resize(n); z.resize(n); }
+    Vec3 operator[](size_t i) const { return {x[i], y[i], z[i]}; }
+    void set(size_t i, Vec3 v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+};
+
+// Batch versions of the above, out is resized to fit and may be the same stream as in.
+// Each element gives exactly the same result as the scalar function.
+void transformPoints(const Vec3Stream &in, const TransformMatrix &m, Vec3Stream &out);
+// Without the translation, for directions
+void transformDirections(const Vec3Stream &in, const TransformMatrix &m, Vec3Stream &out);
+// Like transformProjective, out gets x, y and w
+void transformProjective(const Vec3Stream &in, const TransformMatrix &m, Vec3Stream &out);
+// Only transforms in[begin, end), into out[0, end - begin). For splitting a stream into chunks.
+void transformProjective(const Vec3Stream &in, const TransformMatrix &m, Vec3Stream &out, size_t begin, size_t end);
+
 TransformMatrix makeRotationMatrix(Vec3 R);
-TransformMatrix transposeMatrix(TransformMatrix &mat);
-bool inverseMatrix(TransformMatrix &mat, TransformMatrix &out);
+TransformMatrix transposeMatrix(const TransformMatrix &mat);
+bool inverseMatrix(const TransformMatrix &mat, TransformMatrix &out);
 
 #endif /* __MATRIX_H__ */
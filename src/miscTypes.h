@@ -31,18 +31,56 @@ struct Vertex {
 };
 
 struct Face {
-    uint16_t v1, v2, v3;
+    uint32_t v1, v2, v3;
     shared_ptr<Material> material;
 };
 
+struct Bounds {
+    Vec3 min, max; // Axis aligned bounding box
+    Vec3 center;   // Bounding sphere
+    float radius = -1; // Negative if there is nothing inside
+};
+
+// A small patch of a mesh's faces that is culled as a whole, see Mesh::meshlets
+struct Meshlet {
+    static constexpr uint32_t maxVertices = 64, maxFaces = 124;
+    uint32_t faceBegin, faceEnd;     // Range of MeshletList::faces
+    uint32_t vertexBegin, vertexEnd; // Range of MeshletList::vertices
+};
+
+struct MeshletList {
+    vector<Meshlet> meshlets;
+    vector<uint32_t> faces;    // Indices of Mesh::faces, grouped by meshlet
+    vector<uint32_t> vertices; // Indices of Mesh::vertices, the ones each meshlet uses
+};
+
 struct Mesh {
     std::string label;
     vector<Vertex> vertices;
     vector<Face> faces;
     bool flatShading = false;
+    uint32_t version = 0; // Increment after changing vertices, so cached copies are updated
+    // Simplified versions, each with about half the faces of the one before, see buildLODs.
+    // Can be fewer than requested if the mesh can't be simplified further.
+    vector<shared_ptr<Mesh>> lods;
+    uint32_t lodVersion = 0;
+    size_t lodsRequested = 0;
 
     Mesh(const std::string& label = "", const vector<Vertex>& vertices = {}, const vector<Face>& faces = {}, bool flatShading = false)
         : label(label), vertices(vertices), faces(faces), flatShading(flatShading) {}
+
+    // Bounds of the vertices in object space, recomputed after version changes
+    const Bounds &bounds();
+    // The faces grouped into patches of neighboring faces, recomputed after version changes
+    const MeshletList &meshlets();
+
+  private:
+    Bounds cachedBounds;
+    uint32_t boundsVersion = 0;
+    size_t boundsVertexCount = 0;
+    MeshletList cachedMeshlets;
+    uint32_t meshletsVersion = 0;
+    size_t meshletsFaceCount = 0;
 };
 
 struct Fragment {
@@ -57,21 +95,22 @@ struct Fragment {
     Vector2f dUVdy;
     Color baseColor;
     Face *face;
-    bool isBackFace, inside;
+    bool isBackFace;
 };
 
+// Only lives for one render, while the scene keeps the material and mesh alive, so it doesn't need to own them
 struct Triangle {
     Projection s1, s2, s3;
     Vector2f uv1, uv2, uv3;
-    shared_ptr<Material> mat;
+    Material *mat;
     Face *face;
-    shared_ptr<Mesh> mesh;
+    Mesh *mesh;
     bool cull;
 };
 
 struct TransparentTriangle{
     float z;
-    Triangle tri;
+    uint32_t triangle; // Id, see Camera::transparentTriangle
 };
 
 #endif /* __MISCTYPES_H__ */
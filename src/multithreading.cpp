@@ -1,66 +1,150 @@
 #include "multithreading.h"
+#include "data.h"
+#include <atomic>
 #include <thread>
-#include <condition_variable>
 
-void threadLoop(uint n, uint i0);
-const uint numThreads = std::thread::hardware_concurrency();
-std::vector<std::thread> threads(numThreads);
-std::vector<Camera*> jobReady(numThreads, nullptr);
-bool jobSecondPass = false;
-std::vector<std::condition_variable> cvs(numThreads);
-std::mutex mtx;
-bool shutdown = false;
-bool init = false;
+// Tasks a thread hasn't run yet, begin in the low half and end in the high half, so both change in one atomic operation
+struct alignas(64) TaskRange {
+    std::atomic<uint64_t> range = 0;
+};
+static uint32_t rangeBegin(uint64_t r) { return r; }
+static uint32_t rangeEnd(uint64_t r) { return r >> 32; }
+static uint64_t makeRange(uint32_t begin, uint32_t end) { return (uint64_t)end << 32 | begin; }
 
-void startThreads(Camera *camera, bool secondPass) {
-    if(!init) {
-        for (uint i = 0; i < numThreads; i++)
-            threads[i] = std::thread(threadLoop, numThreads, i);
-        init = true;
+void threadLoop(uint i);
+const uint numThreads = std::max(std::thread::hardware_concurrency(), 1u); // Including the thread calling parallelFor
+std::vector<std::thread> threads;
+std::vector<TaskRange> taskRanges(numThreads); // The calling thread's is the first one
+const std::function<void(size_t)> *currentTask;
+std::atomic<uint32_t> generation = 0; // Incremented when tasks are ready, workers sleep until it changes
+std::atomic<uint32_t> busyWorkers = 0; // Workers still running the current tasks, or looking for some
+std::atomic<bool> shutdown = false;
+thread_local bool insideTask = false;
+
+// Tasks only go from the front of a range to being run, or from the back of it to another range, never back,
+// so a range can't change and then go back to the same value, and compare_exchange is enough
+static bool stealTasks(uint self) {
+    while (true) {
+        uint victim = self;
+        uint64_t seen = 0;
+        uint32_t most = 0;
+        for (uint i = 0; i < numThreads; i++) {
+            uint64_t r = taskRanges[i].range.load();
+            if (i != self && rangeEnd(r) - rangeBegin(r) > most) {
+                most = rangeEnd(r) - rangeBegin(r);
+                victim = i;
+                seen = r;
+            }
+        }
+        if (victim == self)
+            return false;
+        uint32_t begin = rangeBegin(seen), end = rangeEnd(seen), half = (end - begin + 1) / 2;
+        if (taskRanges[victim].range.compare_exchange_strong(seen, makeRange(begin, end - half))) {
+            taskRanges[self].range.store(makeRange(end - half, end));
+            return true;
+        }
     }
-    
-    {
-        std::lock_guard<std::mutex> lock(mtx);
-        for (uint i = 0; i < numThreads; i++)
-            jobReady[i] = camera;
-        jobSecondPass = secondPass;
+}
+
+static void runTasks(uint self) {
+    const std::function<void(size_t)> &task = *currentTask;
+    std::atomic<uint64_t> &own = taskRanges[self].range;
+    insideTask = true;
+    do {
+        uint64_t r = own.load();
+        while (rangeBegin(r) < rangeEnd(r)) {
+            if (own.compare_exchange_weak(r, makeRange(rangeBegin(r) + 1, rangeEnd(r)))) {
+                task(rangeBegin(r));
+                r = own.load();
+            }
+        }
+    } while (stealTasks(self));
+    insideTask = false;
+}
+
+void parallelFor(size_t count, const std::function<void(size_t)> &task) {
+    if (count == 0)
+        return;
+    if (insideTask) {
+        for (size_t i = 0; i < count; i++)
+            task(i);
+        return;
     }
+    if (threads.empty())
+        for (uint i = 1; i < numThreads; i++)
+            threads.emplace_back(threadLoop, i);
 
+    currentTask = &task;
     for (uint i = 0; i < numThreads; i++)
-        cvs[i].notify_one();
+        taskRanges[i].range.store(makeRange(count * i / numThreads, count * (i + 1) / numThreads));
+    busyWorkers.store(threads.size());
+    generation.fetch_add(1);
+    generation.notify_all();
 
-    bool allDone = false;
-    while(!allDone) {
-        std::this_thread::yield();
-        std::lock_guard<std::mutex> lock(mtx);
-        allDone = std::all_of(jobReady.begin(), jobReady.end(), [](Camera *v) {return !v;});
-    }
+    runTasks(0);
+    // Every worker has to be done with this call's tasks before they can be replaced by the next call's
+    for (uint32_t busy; (busy = busyWorkers.load()) != 0;)
+        busyWorkers.wait(busy);
 }
 
-void threadLoop(uint n, uint i) {
+void threadLoop(uint i) {
+    uint32_t seen = 0;
     while (true) {
-        std::unique_lock<std::mutex> lock(mtx);
-        cvs[i].wait(lock, [&] { return jobReady[i] || shutdown; });
-        if(shutdown) break;
-        lock.unlock();
-        if(jobSecondPass)
-            fogPass(n, i, jobReady[i]);
-        else
-            deferredPass(n, i, jobReady[i]);
-        lock.lock();
-        jobReady[i] = nullptr;
+        // Passes come in quick succession, so spin a little before sleeping
+        for (int spin = 0; spin < 256 && generation.load(std::memory_order_relaxed) == seen; spin++)
+            std::this_thread::yield();
+        generation.wait(seen);
+        seen = generation.load();
+        if (shutdown)
+            break;
+        runTasks(i);
+        if (busyWorkers.fetch_sub(1) == 1)
+            busyWorkers.notify_all();
+    }
+}
+
+void startThreads(Camera *camera, ThreadJob job) {
+    RenderTarget *frame = camera->frame;
+    size_t tiles = frame->tileCount.x * frame->tileCount.y;
+    // Every task sets the shading camera of the thread it runs on, tasks of another render may have run there before
+    auto &&pass = [&](void (*run)(Camera *, size_t), size_t count) {
+        parallelFor(count, [&](size_t i) {
+            shadingCamera = camera;
+            run(camera, i);
+        });
+    };
+    switch (job) {
+    case ThreadJob::Vertices:
+        pass(vertexPass, camera->vertexChunks.size());
+        break;
+    case ThreadJob::Primitives:
+        pass(primitivePass, camera->faceChunkCount);
+        break;
+    case ThreadJob::Geometry:
+        pass(geometryPass, tiles);
+        break;
+    case ThreadJob::Deferred:
+        pass(deferredPass, tiles);
+        break;
+    case ThreadJob::TransparencyResolve:
+        pass(transparencyResolvePass, tiles);
+        break;
+    case ThreadJob::Fog:
+        pass(fogPass, tiles);
+        break;
+    case ThreadJob::SkyBox:
+        pass(skyBoxPass, tiles);
+        break;
     }
 }
 
 void shutdownThreads() {
-    if(!init)
+    if(threads.empty())
         return;
-    {
-        std::lock_guard<std::mutex> lock(mtx);
-        shutdown = true;
-    }
-    for(auto &cv : cvs)
-        cv.notify_all();
+    shutdown = true;
+    generation.fetch_add(1);
+    generation.notify_all();
     for(auto &t : threads)
         t.join();
-}
\ No newline at end of file
+    threads.clear();
+}
@@ -1,8 +1,16 @@
 #ifndef __MULTITHREADING_H__
 #define __MULTITHREADING_H__
 #include "camera.h"
+#include <functional>
 
-void startThreads(Camera *camera, bool secondPass);
+enum class ThreadJob { Vertices, Primitives, Geometry, Deferred, TransparencyResolve, Fog, SkyBox };
+
+// Runs a pass of the camera's render, one task per chunk or screen tile
+void startThreads(Camera *camera, ThreadJob job);
+// Runs task(i) for every i below count on the worker threads and the calling thread, and returns once all are done.
+// Each thread starts with an equal share of the tasks, threads that run out steal half of the largest share left.
+// Called from inside a task, the tasks run on the calling thread, so independent renders can each be one task.
+void parallelFor(size_t count, const std::function<void(size_t)> &task);
 void shutdownThreads();
 
 #endif /* __MULTITHREADING_H__ */
@@ -1,7 +1,10 @@
 #include "object.h"
 #include <imgui.h>
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include "data.h"
+#include "generateMesh.h"
 
 void Object::update() {
     for (auto &&c : components)
@@ -41,6 +44,150 @@ void Object::update() {
         c->update();
 }
 
+// Found from the world space vertices, so they're exact for any transform, even mirroring or non-uniform scale.
+// The normal cone is from the winding, like the rasterizer's back-face culling, not from the vertex normals.
+static MeshletBounds meshletBounds(const Mesh &mesh, const MeshletList &list, const Meshlet &meshlet, const Vec3Stream &positions) {
+    MeshletBounds bounds{};
+    Vec3 min{INFINITY, INFINITY, INFINITY}, max = -min;
+    for (uint32_t i = meshlet.vertexBegin; i < meshlet.vertexEnd; i++) {
+        Vec3 p = positions[list.vertices[i]];
+        min = {std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z)};
+        max = {std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z)};
+    }
+    bounds.center = (min + max) / 2;
+    for (uint32_t i = meshlet.vertexBegin; i < meshlet.vertexEnd; i++)
+        bounds.radius = std::max(bounds.radius, (positions[list.vertices[i]] - bounds.center).length());
+
+    for (uint32_t i = meshlet.faceBegin; i < meshlet.faceEnd; i++) {
+        const Face &face = mesh.faces[list.faces[i]];
+        Vec3 a = positions[face.v1], b = positions[face.v2], c = positions[face.v3];
+        Vec3 normal = (b - a).cross(c - a);
+        float length = normal.length();
+        if (length > 0)
+            bounds.coneAxis += normal / length;
+    }
+
+    bounds.coneCutoff = 1;
+    float axisLength = bounds.coneAxis.length();
+    if (axisLength == 0)
+        return bounds;
+    bounds.coneAxis /= axisLength;
+    float minDot = 1;
+    for (uint32_t i = meshlet.faceBegin; i < meshlet.faceEnd; i++) {
+        const Face &face = mesh.faces[list.faces[i]];
+        Vec3 a = positions[face.v1];
+        Vec3 normal = (positions[face.v2] - a).cross(positions[face.v3] - a);
+        float length = normal.length();
+        if (length > 0)
+            minDot = std::min(minDot, normal.dot(bounds.coneAxis) / length);
+    }
+    if (minDot > 0)
+        bounds.coneCutoff = std::sqrt(1 - minDot * minDot);
+    return bounds;
+}
+
+void MeshComponent::update() {
+    // Most objects don't move, only the ones that did need their part of the scene's tree refitted
+    if (bvhMesh == mesh.get() && bvhMeshVersion == mesh->version && bvhTransform == obj->transform)
+        return;
+    bvhMesh = mesh.get();
+    bvhMeshVersion = mesh->version;
+    bvhTransform = obj->transform;
+    if (shared_ptr<Scene> s = obj->scene.lock())
+        s->bvh.invalidate(this);
+}
+
+Mesh *MeshComponent::lodMesh(size_t level) {
+    std::lock_guard lock(meshCacheMutex); // Another camera may be adding LODs
+    return level ? mesh->lods[level - 1].get() : mesh.get();
+}
+
+const WorldVertices &MeshComponent::worldVertices(size_t level) {
+    std::lock_guard lock(worldVertexMutex);
+    if (worldVertexCache.size() <= level)
+        worldVertexCache.resize(level + 1);
+    WorldVertexCache &cache = worldVertexCache[level];
+    Mesh *mesh = lodMesh(level);
+    if (
+        cache.mesh != mesh ||
+        cache.meshVersion != mesh->version ||
+        cache.transform != obj->transform || // transformNormals only changes with it
+        cache.vertices.positions.size() != mesh->vertices.size()
+    ) {
+        Vec3Stream &positions = cache.vertices.positions, &normals = cache.vertices.normals;
+        positions.resize(mesh->vertices.size());
+        normals.resize(mesh->vertices.size());
+        for (size_t i = 0; i < mesh->vertices.size(); i++) {
+            positions.set(i, mesh->vertices[i].position);
+            normals.set(i, mesh->vertices[i].normal);
+        }
+        transformPoints(positions, obj->transform, positions);
+        transformDirections(normals, obj->transformNormals, normals);
+        for (size_t i = 0; i < normals.size(); i++)
+            normals.set(i, normals[i].normalized());
+        const MeshletList &meshlets = mesh->meshlets();
+        cache.vertices.meshlets.resize(meshlets.meshlets.size());
+        for (size_t i = 0; i < meshlets.meshlets.size(); i++)
+            cache.vertices.meshlets[i] = meshletBounds(*mesh, meshlets, meshlets.meshlets[i], positions);
+        cache.mesh = mesh;
+        cache.meshVersion = mesh->version;
+        cache.transform = obj->transform;
+    }
+    return cache.vertices;
+}
+
+size_t MeshComponent::lodLevel(Camera *camera) {
+    if (lodThresholds.empty())
+        return 0;
+    Bounds bounds = worldBounds();
+    float size = camera->projectedSize(bounds.center, bounds.radius);
+    size_t level = 0;
+    while (level < lodThresholds.size() && size < lodThresholds[level])
+        level++;
+    if (level == 0)
+        return 0;
+    buildLODs(*mesh, lodThresholds.size());
+    return std::min(level, mesh->lods.size());
+}
+
+void MeshComponent::GUI() {
+    float thresholds[4] = {};
+    int count = std::min(lodThresholds.size(), (size_t)4);
+    std::copy_n(lodThresholds.begin(), count, thresholds);
+    if (ImGui::SliderInt("LOD levels", &count, 0, 4))
+        lodThresholds.resize(count, lodThresholds.empty() ? 0.2f : lodThresholds.back() / 2);
+    else if (count && ImGui::DragScalarN("LOD thresholds", ImGuiDataType_Float, thresholds, count, 0.005f))
+        std::copy_n(thresholds, count, lodThresholds.begin());
+}
+
+Bounds MeshComponent::worldBounds() {
+    const Bounds &local = mesh->bounds();
+    const TransformMatrix &m = obj->transform;
+    Bounds world;
+    if (local.radius < 0)
+        return world;
+
+    // Each axis of the box adds its extent along every world axis (Arvo)
+    world.min = world.max = {m[12], m[13], m[14]};
+    float localMin[3] = {local.min.x, local.min.y, local.min.z}, localMax[3] = {local.max.x, local.max.y, local.max.z};
+    float *worldMin = &world.min.x, *worldMax = &world.max.x;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            float a = localMin[i] * m[i * 4 + j], b = localMax[i] * m[i * 4 + j];
+            worldMin[j] += std::min(a, b);
+            worldMax[j] += std::max(a, b);
+        }
+    }
+
+    // Largest scale of any axis
+    float scale = 0;
+    for (int i = 0; i < 3; i++)
+        scale = std::max(scale, Vec3{m[i * 4], m[i * 4 + 1], m[i * 4 + 2]}.lengthSquared());
+    world.center = local.center * m;
+    world.radius = local.radius * std::sqrt(scale);
+    return world;
+}
+
 void Object::GUI() {
     if(ImGui::TreeNode(name.c_str())) {
         ImGui::SliderFloat3("Rotation", (float *)&rotation, -M_PI, M_PI);
@@ -2,8 +2,10 @@
 #define __OBJECT_H__
 #include "matrix.h"
 #include "miscTypes.h"
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 
 struct Object;
@@ -49,11 +51,55 @@ struct Object {
     }
 };
 
+// World space bounds of a meshlet, for culling it without looking at its faces
+struct MeshletBounds {
+    Vec3 center;
+    float radius;
+    Vec3 coneAxis;    // Average normal of the faces
+    float coneCutoff; // Sine of the largest angle between a normal and the axis, 1 if no side sees only back faces
+};
+
+struct WorldVertices {
+    Vec3Stream positions;
+    Vec3Stream normals;
+    std::vector<MeshletBounds> meshlets; // Same order as Mesh::meshlets
+};
+
+class Camera;
+
 class MeshComponent : public Component {
   public:
     shared_ptr<Mesh> mesh;
+    // Level of detail i + 1 is used when the mesh covers less than lodThresholds[i] of the view's height.
+    // Must be decreasing. Empty disables LOD, the simplified meshes are only built when first needed.
+    std::vector<float> lodThresholds;
     MeshComponent(shared_ptr<Mesh> mesh) : mesh(mesh) {}
     std::string name() { return "Mesh: " + mesh->label; }
+    // Tells the scene's tree when the transform or the mesh changed
+    void update() override;
+    // 0 for the mesh itself, otherwise mesh->lods[level - 1]
+    size_t lodLevel(Camera *camera);
+    Mesh *lodMesh(size_t level);
+    // The vertices of a level of the mesh in world space, shared by all cameras. Only recomputed when the transform or the mesh changed.
+    // Cameras rendering at the same time may ask for them, the first one computes them and the others wait.
+    const WorldVertices &worldVertices(size_t level = 0);
+    // The mesh's bounds in world space. The box contains the transformed box of the mesh, so it may be a bit bigger.
+    Bounds worldBounds();
+    void GUI();
+
+  private:
+    struct WorldVertexCache {
+        WorldVertices vertices;
+        TransformMatrix transform;
+        Mesh *mesh = nullptr;
+        uint32_t meshVersion = 0;
+    };
+    // What the scene's tree last got told about
+    Mesh *bvhMesh = nullptr;
+    uint32_t bvhMeshVersion = 0;
+    TransformMatrix bvhTransform;
+    std::deque<WorldVertexCache> worldVertexCache; // One for each level of detail, a deque so adding levels doesn't move the others
+    std::mutex worldVertexMutex;
 };
 
 class RotatorComponent : public Component {
@@ -52,7 +52,7 @@ float GeometrySmith(Vec3 N, Vec3 V, Vec3 L, float roughness)
 }
 
 Color PBRMaterial::shade(Fragment &f, Color previous, Scene &scene) {
-    shared_ptr<Camera> camera = currentWindow->camera;
+    Camera *camera = shadingCamera;
     Color albedo = f.baseColor;
     float metallic = this->metallic->sample(f);
     float roughness = this->roughness->sample(f);
@@ -64,8 +64,8 @@ Color PBRMaterial::shade(Fragment &f, Color previous, Scene &scene) {
         (f.worldPos - camera->obj->globalPosition).normalized();
 
     Color Lo{0, 0, 0, 0};
-    for (size_t i = 0; i < scene.lights.size(); i++) {
-        auto [radiance, L] = scene.lights[i]->sample(f.worldPos, scene);
+    camera->forEachLight(f.screenPos, f.z, [&](Light *light) {
+        auto [radiance, L] = light->sample(f.worldPos, scene);
         Vec3 H = (L + V).normalized();
         Color F0{0.04f, 0.04f, 0.04f, 1.0f};
         F0 = Color::mix(F0, albedo, metallic);
@@ -80,12 +80,12 @@ Color PBRMaterial::shade(Fragment &f, Color previous, Scene &scene) {
         kD *= 1.0f - metallic;
         float NdotL = max(N.dot(L), 0.0f);        
         Lo += (kD * albedo / M_PIf + specular) * radiance * NdotL;
-    }
+    });
     Color ambient = scene.ambientLight * scene.ambientLight.a * albedo * ao;
     Color res = ambient + Lo;
 
-    if(currentWindow->camera->whitePoint == 0) // Don't waste cycles if it won't be used
-        currentWindow->camera->maximumColor = max(currentWindow->camera->maximumColor, res.luminance()); // This doesn't take transparency into account
+    if(camera->whitePoint == 0) // Don't waste cycles if it won't be used
+        camera->maximumColor = max(camera->maximumColor, res.luminance()); // This doesn't take transparency into account
 
     return res;
 }
\ No newline at end of file
@@ -24,7 +24,7 @@ void PhongMaterial::GUI() {
 }
 
 Color PhongMaterial::shade(Fragment &f, Color previous, Scene &scene) {
-    shared_ptr<Camera> camera = currentWindow->camera;
+    Camera *camera = shadingCamera;
     Vec3 viewDir = camera->orthographic ?
         Vec3{0, 0, -1} * camera->obj->transformRotation :
         (camera->obj->globalPosition - f.worldPos).normalized();
@@ -47,11 +47,10 @@ Color PhongMaterial::shade(Fragment &f, Color previous, Scene &scene) {
         normal = normal.normalized();
     }
 
-    for (size_t i = 0; i < scene.lights.size(); i++)
-    {
-        auto [light, direction] = scene.lights[i]->sample(f.worldPos, scene);
+    camera->forEachLight(f.screenPos, f.z, [&](Light *source) {
+        auto [light, direction] = source->sample(f.worldPos, scene);
 
-        if(light.a == 0) continue; // No light received, don't bother calculating
+        if(light.a == 0) return; // No light received, don't bother calculating
 
         float receivedLight = normal.dot(direction);
 
@@ -76,7 +75,7 @@ Color PhongMaterial::shade(Fragment &f, Color previous, Scene &scene) {
                 specularIntensity = 0;
             specular += light * specularIntensity;
         }
-    }
+    });
 
     Color matTint{0,0,0,0};
     if (!flags.transparent && flags.doubleSided)
@@ -99,8 +98,8 @@ Color PhongMaterial::shade(Fragment &f, Color previous, Scene &scene) {
         lighting = previous * matTint + lighting;
     }
 
-    if(currentWindow->camera->whitePoint == 0) // Don't waste cycles if it won't be used
-        currentWindow->camera->maximumColor = max(currentWindow->camera->maximumColor, lighting.luminance()); // This doesn't take transparency into account
+    if(camera->whitePoint == 0) // Don't waste cycles if it won't be used
+        camera->maximumColor = max(camera->maximumColor, lighting.luminance()); // This doesn't take transparency into account
 
     return lighting;
 }
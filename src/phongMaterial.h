@@ -32,6 +32,10 @@ public:
         return mat.diffuse->sample(uv, dUVdx, dUVdy);
     }
 
+    Color transmittance(Fragment &f) {
+        return flags.transparent ? mat.tint->sample(f) : Color{0, 0, 0, 0};
+    }
+
     void GUI();
 
     Color shade(Fragment &f, Color previous, Scene &scene);
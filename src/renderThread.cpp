@@ -0,0 +1,61 @@
+#include "renderThread.h"
+#include "frameGraph.h"
+#include <map>
+
+RenderThread renderThread;
+
+static void renderWindows(const std::vector<shared_ptr<Window>> &windows) {
+    // The shadow maps render in parallel, then the window cameras one at a time
+    FrameGraph graph;
+    std::map<Scene *, std::vector<const void *>> shadowMaps;
+    for (auto &&window : windows) {
+        auto [it, added] = shadowMaps.try_emplace(window->scene.get());
+        if (added)
+            it->second = graph.addScene(*window->scene);
+        graph.addCamera(window->camera.get(), it->second);
+    }
+    graph.execute();
+
+    for (auto &&window : windows) {
+        // The z buffer is overwritten by the next render, so it's always shown right away
+        window->renderedImage = window->pipelined && window->scene->renderMode == 0 ?
+            window->presentPipelined() : window->camera->getRenderedFrame(window->scene->renderMode);
+        window->renderedImageReady = true;
+    }
+}
+
+void RenderThread::start(std::vector<shared_ptr<Window>> windows) {
+    if (!thread.joinable())
+        thread = std::thread(&RenderThread::loop, this);
+    {
+        std::lock_guard lock(mutex);
+        job = std::move(windows);
+        rendering = true;
+    }
+    wake.notify_one();
+}
+
+void RenderThread::stop() {
+    if (!thread.joinable())
+        return;
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+    job.clear();
+}
+
+void RenderThread::loop() {
+    std::unique_lock lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return rendering || stopping; });
+        if (!rendering)
+            return;
+        lock.unlock();
+        renderWindows(job);
+        lock.lock();
+        rendering = false;
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef __RENDERTHREAD_H__
+#define __RENDERTHREAD_H__
+#include "data.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Renders the windows' cameras on a thread of its own, so the windows keep handling events and drawing their GUI
+// while a frame renders. While it's busy it owns the scenes, nothing else may change them.
+class RenderThread {
+  public:
+    ~RenderThread() { stop(); }
+    // Renders the windows' cameras and leaves each window's image in Window::renderedImage. Must not be busy.
+    void start(std::vector<shared_ptr<Window>> windows);
+    // Once this is false, the images of the last frame are ready and the scenes can be changed again
+    bool busy() const { return rendering.load(); }
+    // Finishes the frame being rendered and ends the thread
+    void stop();
+
+  private:
+    void loop();
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<shared_ptr<Window>> job; // Only released by the window loop, windows must be destroyed on its thread
+    std::atomic<bool> rendering = false;
+    bool stopping = false;
+};
+
+extern RenderThread renderThread;
+
+#endif /* __RENDERTHREAD_H__ */
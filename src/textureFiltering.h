@@ -117,7 +117,8 @@ private:
 public:
     T sample(Vector2f uv, Vector2f dUVdx, Vector2f dUVdy) {
         TextureFilteringMode mode =
-            filteringMode == TextureFilteringMode::None ? currentWindow->scene->textureFilteringMode : filteringMode;
+            filteringMode != TextureFilteringMode::None ? filteringMode :
+            shadingCamera ? shadingCamera->renderScene->textureFilteringMode : TextureFilteringMode::NearestNeighbor;
         // Check mip level
         float rho = max(dUVdx.length(), dUVdy.length());
         Vector2f mipLevelF{
@@ -5,13 +5,50 @@
 #include "fog.h"
 #include <SFML/System/Vector2.hpp>
 #include <SFML/Graphics/Image.hpp>
+#include <bit>
 #include <cstdint>
 #include <iostream>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 
 using sf::Vector2f, sf::Vector2u, sf::Vector2i;
-using std::swap, std::min, std::max, std::abs, std::round;
+using std::swap, std::abs, std::round;
 
 
+// Returns a bit for each of the rasterLanes pixels starting at edge values e1..e3, set if it's inside all three edges.
+// d1..d3 are how much each edge value changes per pixel to the right.
+#if defined(__AVX2__)
+constexpr int rasterLanes = 8;
+inline uint32_t coverageMask(float e1, float e2, float e3, float d1, float d2, float d3) {
+    const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 in1 = _mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e1), _mm256_mul_ps(_mm256_set1_ps(d1), lane)), zero, _CMP_GE_OQ);
+    __m256 in2 = _mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e2), _mm256_mul_ps(_mm256_set1_ps(d2), lane)), zero, _CMP_GE_OQ);
+    __m256 in3 = _mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e3), _mm256_mul_ps(_mm256_set1_ps(d3), lane)), zero, _CMP_GE_OQ);
+    return _mm256_movemask_ps(_mm256_and_ps(_mm256_and_ps(in1, in2), in3));
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+constexpr int rasterLanes = 4;
+inline uint32_t coverageMask(float e1, float e2, float e3, float d1, float d2, float d3) {
+    const __m128 lane = _mm_setr_ps(0, 1, 2, 3);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 in1 = _mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(e1), _mm_mul_ps(_mm_set1_ps(d1), lane)), zero);
+    __m128 in2 = _mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(e2), _mm_mul_ps(_mm_set1_ps(d2), lane)), zero);
+    __m128 in3 = _mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(e3), _mm_mul_ps(_mm_set1_ps(d3), lane)), zero);
+    return _mm_movemask_ps(_mm_and_ps(_mm_and_ps(in1, in2), in3));
+}
+#else
+constexpr int rasterLanes = 8;
+inline uint32_t coverageMask(float e1, float e2, float e3, float d1, float d2, float d3) {
+    uint32_t mask = 0;
+    for (int i = 0; i < rasterLanes; i++, e1 += d1, e2 += d2, e3 += d3)
+        if (e1 >= 0 && e2 >= 0 && e3 >= 0)
+            mask |= 1u << i;
+    return mask;
+}
+#endif
+
 Vector2f v3to2(Vec3 in) {
     return Vector2f{in.x, in.y};
 }
@@ -19,7 +56,7 @@ Vector2f v2abs(Vector2f in) {
     return Vector2f{abs(in.x), abs(in.y)};
 }
 
-void drawLine(Vector2f from, Vector2f to, RenderTarget *frame) {
+void drawLine(Vector2f from, Vector2f to, RenderTarget *frame, Vector2i min, Vector2i max) {
     Color color = Color{0, 0, 0, 1};
 
     int x0 = round(from.x);
@@ -34,7 +71,7 @@ void drawLine(Vector2f from, Vector2f to, RenderTarget *frame) {
     int err = dx - dy;
 
     while (true) {
-        if (x0 >= 0 && y0 >= 0 && x0 < (int)frame->size.x && y0 < (int)frame->size.y)
+        if (x0 >= min.x && y0 >= min.y && x0 < max.x && y0 < max.y)
             frame->framebuffer[x0 + y0 * frame->size.x] = color;
 
         if (x0 == x1 && y0 == y1)
@@ -52,17 +89,99 @@ void drawLine(Vector2f from, Vector2f to, RenderTarget *frame) {
     }
 }
 
-void drawTriangle(Camera *camera, Triangle tri, bool defer) {
+Vector2f toScreen(Vec3 screenPos, RenderTarget *frame) {
+    return (v3to2(screenPos) + Vector2f{1, 1}).componentWiseMul(Vector2f{frame->size.x / 2.0f, frame->size.y / 2.0f});
+}
+
+// Weighted blended order independent transparency (McGuire and Bavoil 2013) weighs closer fragments more, with
+// equation 9 of the paper. z is the view space depth in world units, and the weight falls off around the scale's depth.
+// The scale is the paper's, tuned for scenes a few hundred units deep, it needs changing for scenes of a very different size.
+constexpr float weightedBlendedDepthScale = 200;
+// The clamp keeps the weights of very close and very far fragments within what the accumulation's floats hold precisely
+constexpr float weightedBlendedMinWeight = 1e-2f, weightedBlendedMaxWeight = 3e3f;
+
+static float weightedBlendedDepthWeight(float z) {
+    // The numerator and the small bias that keeps it finite at z = 0 are the paper's
+    float weight = 0.03f / (1e-5f + std::pow(z / weightedBlendedDepthScale, 4.0f));
+    return std::clamp(weight, weightedBlendedMinWeight, weightedBlendedMaxWeight);
+}
+
+// Vertices may be this many times the screen size outside the screen before triangles get clipped.
+// Pixels outside the screen are never visited anyway, this only keeps the edge functions precise:
+// each piece is binned by its own bounds, clamped to the screen, and drawn only where they overlap a tile.
+constexpr float guardBand = 8;
+
+struct ClipVertex {
+    Projection p;
+    Vector2f uv;
+};
+
+bool clipTriangle(Camera *camera, Triangle &tri, std::vector<Triangle> &out) {
+    // Signed distances to the clip planes, positive inside. They must be linear in world space so
+    // clipped vertices can be interpolated, which is why side planes are multiplied by z.
+    auto &&distance = [&](const Projection &p, int plane) -> float {
+        Vec3 s = p.screenPos;
+        float w = camera->orthographic ? 1 : s.z;
+        switch (plane) {
+        case 0: return s.z - camera->nearClip;
+        case 1: return (guardBand + s.x) * w;
+        case 2: return (guardBand - s.x) * w;
+        case 3: return (guardBand + s.y) * w;
+        default: return (guardBand - s.y) * w;
+        }
+    };
+
+    bool needsClipping = false;
+    for (int plane = 0; plane < 5; plane++)
+        if (distance(tri.s1, plane) < 0 || distance(tri.s2, plane) < 0 || distance(tri.s3, plane) < 0)
+            needsClipping = true;
+    if (!needsClipping)
+        return false;
+
+    // Sutherland-Hodgman, each plane can add at most one vertex
+    ClipVertex polygon[8] = {{tri.s1, tri.uv1}, {tri.s2, tri.uv2}, {tri.s3, tri.uv3}}, clipped[8];
+    int n = 3;
+    for (int plane = 0; plane < 5 && n > 0; plane++) {
+        int m = 0;
+        for (int i = 0; i < n; i++) {
+            ClipVertex &from = polygon[i], &to = polygon[(i + 1) % n];
+            float dFrom = distance(from.p, plane), dTo = distance(to.p, plane);
+            if (dFrom >= 0)
+                clipped[m++] = from;
+            if ((dFrom >= 0) != (dTo >= 0)) {
+                float t = dFrom / (dFrom - dTo);
+                Vec3 worldPos = from.p.worldPos + (to.p.worldPos - from.p.worldPos) * t;
+                Projection p = camera->perspectiveProject(worldPos);
+                p.normal = from.p.normal + (to.p.normal - from.p.normal) * t;
+                clipped[m++] = {p, from.uv + (to.uv - from.uv) * t};
+            }
+        }
+        std::copy(clipped, clipped + m, polygon);
+        n = m;
+    }
+
+    for (int i = 1; i + 1 < n; i++) { // Triangle fan keeps the winding
+        Triangle piece = tri;
+        piece.s1 = polygon[0].p;   piece.uv1 = polygon[0].uv;
+        piece.s2 = polygon[i].p;   piece.uv2 = polygon[i].uv;
+        piece.s3 = polygon[i+1].p; piece.uv3 = polygon[i+1].uv;
+        // Original vertices behind the camera flipped the screen space winding, so find it again
+        piece.cull = (piece.s3.screenPos - piece.s1.screenPos).cross(piece.s2.screenPos - piece.s1.screenPos).z < 0;
+        out.push_back(piece);
+    }
+    return true;
+}
+
+bool triangleScreenBounds(Camera *camera, Triangle &tri, Vector2i &min, Vector2i &max) {
     RenderTarget *frame = camera->frame;
-    shared_ptr<Scene> scene = camera->obj->scene.lock();
-    if(!scene) return;
+    Scene *scene = camera->renderScene;
 
     if (
             (camera->shadowMap ? !tri.cull : tri.cull) && // Shadow maps have front face culling
             scene->backFaceCulling &&
             !(tri.mat->flags.transparent || tri.mat->flags.doubleSided)
     )
-        return;
+        return false;
 
     if (
         (tri.s1.screenPos.x < -1 && tri.s2.screenPos.x < -1 && tri.s3.screenPos.x < -1) || // Frustum culling left
@@ -73,19 +192,36 @@ void drawTriangle(Camera *camera, Triangle tri, bool defer) {
         (tri.s1.screenPos.z >  camera->farClip && tri.s2.screenPos.z >  camera->farClip && tri.s3.screenPos.z >  camera->farClip) || // Too far
         !(tri.s1.screenPos.z > 0 && tri.s2.screenPos.z > 0 && tri.s3.screenPos.z > 0) // negative z
     )
-        return;
+        return false;
+
+    Vector2f a = toScreen(tri.s1.screenPos, frame),
+             b = toScreen(tri.s2.screenPos, frame),
+             c = toScreen(tri.s3.screenPos, frame);
+
+    min = {
+        std::max((int)std::floor(std::min({a.x, b.x, c.x})), 0),
+        std::max((int)std::floor(std::min({a.y, b.y, c.y})), 0),
+    };
+    max = {
+        std::min((int)std::ceil(std::max({a.x, b.x, c.x})), (int)frame->size.x),
+        std::min((int)std::ceil(std::max({a.y, b.y, c.y})), (int)frame->size.y),
+    };
+    return min.x < max.x && min.y < max.y;
+}
 
-    Vector2f a = (v3to2(tri.s1.screenPos) + Vector2f{1, 1}).componentWiseMul(Vector2f{frame->size.x / 2.0f, frame->size.y / 2.0f}),
-             b = (v3to2(tri.s2.screenPos) + Vector2f{1, 1}).componentWiseMul(Vector2f{frame->size.x / 2.0f, frame->size.y / 2.0f}),
-             c = (v3to2(tri.s3.screenPos) + Vector2f{1, 1}).componentWiseMul(Vector2f{frame->size.x / 2.0f, frame->size.y / 2.0f});
+TriangleSetup::TriangleSetup(Camera *camera, Triangle &tri) : tri(&tri) {
+    RenderTarget *frame = camera->frame;
+    a = toScreen(tri.s1.screenPos, frame);
+    b = toScreen(tri.s2.screenPos, frame);
+    c = toScreen(tri.s3.screenPos, frame);
 
-    float areaOfTriangle = abs((b - a).cross(c - a)); // Two times the area of the triangle
+    area = (b - a).cross(c - a); // Two times the signed area of the triangle, negative if it's front-facing
 
-    Vec3 triangleNormal = tri.mesh->flatShading ?
+    triangleNormal = tri.mesh->flatShading ?
          (tri.s3.worldPos - tri.s1.worldPos).cross(tri.s2.worldPos - tri.s1.worldPos).normalized()
          : Vec3{0,0,0};
 
-    Vec3 tangent{}, bitangent{};
+    tangent = bitangent = Vec3{};
     if (tri.mat->needsTBN) {
         Vec3 edge1 = tri.s2.worldPos - tri.s1.worldPos;
         Vec3 edge2 = tri.s3.worldPos - tri.s1.worldPos; 
@@ -104,92 +240,116 @@ void drawTriangle(Camera *camera, Triangle tri, bool defer) {
         }.normalized();
     }
 
-    auto &&getFragment = [&](Vector2i p) -> Fragment {
-        Vector2f pp = {(float)p.x + 0.5f, (float)p.y + 0.5f};
-        float C1 = -(b-pp).cross(c-pp) / areaOfTriangle;
-        float C2 = -(c-pp).cross(a-pp) / areaOfTriangle;
-        if (tri.cull) { // If backface, C1 and C2 are negative
-            C1 *= -1;
-            C2 *= -1;
-        }
-        float C3 = 1.0f - C1 - C2; // C1+C2+C3=1 so take a shortcut
-        bool inside = C1 >= 0 && C2 >= 0 && C3 >= 0;
-        if(!camera->orthographic) {
-            C1 /= tri.s1.screenPos.z; // Perspective correction
-            C2 /= tri.s2.screenPos.z;
-            C3 /= tri.s3.screenPos.z;
-        }
-        float denom = 1 / (C1 + C2 + C3);
-
-        #define INTERPOLATE_TRI(A,B,C) ((C1*(A) + C2*(B) + C3*(C))*denom)
-        float z =           INTERPOLATE_TRI(tri.s1.screenPos.z, tri.s2.screenPos.z, tri.s3.screenPos.z);
-        Vec3 normal = tri.mesh->flatShading ? triangleNormal : 
-                            INTERPOLATE_TRI(tri.s1.normal, tri.s2.normal, tri.s3.normal).normalized();
-        Vec3 worldPos = INTERPOLATE_TRI(tri.s1.worldPos, tri.s2.worldPos, tri.s3.worldPos);
-        Vector2f uv =       INTERPOLATE_TRI(tri.uv1, tri.uv2, tri.uv3);
-        #undef INTERPOLATE_TRI
-
-        Fragment f{
-            .screenPos = p,
-            .z = z,
-            .worldPos = worldPos,
-            .normal = normal,
-            .tangent = tangent,
-            .bitangent = bitangent,
-            .uv = uv,
-            .face = tri.face,
-            .isBackFace = tri.cull,
-            .inside = inside
-        };
-        return f;
+    // Barycentric coordinates are linear in screen space, and so are barycentric / z (perspective correction)
+    C1 = {(b.y - c.y) / area, (c.x - b.x) / area, b.cross(c) / area};
+    C2 = {(c.y - a.y) / area, (a.x - c.x) / area, c.cross(a) / area};
+    C3 = {(a.y - b.y) / area, (b.x - a.x) / area, a.cross(b) / area};
+    invZ = camera->orthographic ? Vec3{1, 1, 1} :
+        Vec3{1 / tri.s1.screenPos.z, 1 / tri.s2.screenPos.z, 1 / tri.s3.screenPos.z};
+    W = C1 * invZ.x + C2 * invZ.y + C3 * invZ.z;
+    U = C1 * (invZ.x * tri.uv1.x) + C2 * (invZ.y * tri.uv2.x) + C3 * (invZ.z * tri.uv3.x);
+    V = C1 * (invZ.x * tri.uv1.y) + C2 * (invZ.y * tri.uv2.y) + C3 * (invZ.z * tri.uv3.y);
+}
+
+float TriangleSetup::depth(Vector2f pp) const {
+    float c1 = C1.at(pp) * invZ.x;
+    float c2 = C2.at(pp) * invZ.y;
+    float c3 = C3.at(pp) * invZ.z;
+    return (c1 * tri->s1.screenPos.z + c2 * tri->s2.screenPos.z + c3 * tri->s3.screenPos.z) * (1 / (c1 + c2 + c3));
+}
+
+Fragment TriangleSetup::fragment(Vector2i p, float z) const {
+    Vector2f pp = {(float)p.x + 0.5f, (float)p.y + 0.5f};
+    float c1 = C1.at(pp) * invZ.x;
+    float c2 = C2.at(pp) * invZ.y;
+    float c3 = C3.at(pp) * invZ.z;
+    float denom = 1 / (c1 + c2 + c3);
+
+    #define INTERPOLATE_TRI(A,B,C) ((c1*(A) + c2*(B) + c3*(C))*denom)
+    Vec3 normal = tri->mesh->flatShading ? triangleNormal : 
+                        INTERPOLATE_TRI(tri->s1.normal, tri->s2.normal, tri->s3.normal).normalized();
+    Vec3 worldPos = INTERPOLATE_TRI(tri->s1.worldPos, tri->s2.worldPos, tri->s3.worldPos);
+    #undef INTERPOLATE_TRI
+
+    // UV derivatives from the plane equations: d(U/W)/dx = (dU/dx - uv * dW/dx) / W
+    Vector2f uv{U.at(pp) * denom, V.at(pp) * denom};
+    Vector2f dUVdx{(U.dx - uv.x * W.dx) * denom, (V.dx - uv.y * W.dx) * denom};
+    Vector2f dUVdy{(U.dy - uv.x * W.dy) * denom, (V.dy - uv.y * W.dy) * denom};
+
+    return Fragment{
+        .screenPos = p,
+        .z = z,
+        .worldPos = worldPos,
+        .normal = normal,
+        .tangent = tangent,
+        .bitangent = bitangent,
+        .uv = uv,
+        .dUVdx = dUVdx,
+        .dUVdy = dUVdy,
+        .face = tri->face,
+        .isBackFace = tri->cull,
     };
-    auto &&postFragment = [&](Fragment &f) -> void {
-        if (
-            f.screenPos.x < 0 || 
-            f.screenPos.y < 0 || 
-            f.screenPos.x >= (int)frame->size.x || 
-            f.screenPos.y >= (int)frame->size.y ||
-            !f.inside
-        )
-            return;
+}
+
+void drawTriangle(Camera *camera, Triangle tri, DrawMode mode) {
+    Vector2i min, max;
+    if (!triangleScreenBounds(camera, tri, min, max))
+        return;
+    if (camera->renderScene->wireFrame) // The lines' rounded ends can be one pixel past the bounds
+        max = {std::min(max.x + 1, (int)camera->frame->size.x), std::min(max.y + 1, (int)camera->frame->size.y)};
+    drawTriangle(camera, tri, mode, min, max, 0);
+}
+
+void drawTriangle(Camera *camera, Triangle &tri, DrawMode mode, Vector2i min, Vector2i max, uint32_t triangleId) {
+    RenderTarget *frame = camera->frame;
+    Scene *scene = camera->renderScene;
+    bool defer = mode == DrawMode::Deferred;
+    bool shade = mode == DrawMode::Forward || mode == DrawMode::DepthEqual || mode == DrawMode::WeightedBlended;
+
+    Vec3 depths{tri.s1.screenPos.z, tri.s2.screenPos.z, tri.s3.screenPos.z};
+    float zMin = std::min({depths.x, depths.y, depths.z}), zMax = std::max({depths.x, depths.y, depths.z});
+
+    // Whole triangle is behind everything already drawn here
+    if (!scene->wireFrame && zMin > frame->maxDepth(min, max))
+        return;
+
+    TriangleSetup setup(camera, tri);
+    Vector2f a = setup.a, b = setup.b, c = setup.c;
+    const ScreenPlane &C1 = setup.C1, &C2 = setup.C2, &C3 = setup.C3;
+
+    // Returns whether the z-buffer was written
+    auto &&postFragment = [&](Fragment &f) -> bool {
         size_t index = f.screenPos.x + f.screenPos.y * frame->size.x;
 
         Color baseColor = f.baseColor =
-            (defer && !tri.mat->flags.alphaCutout)
+            (!shade && !tri.mat->flags.alphaCutout)
                 ? Color{0, 0, 0, 1}
                 : tri.mat->getBaseColor(f.uv, f.dUVdx, f.dUVdy);
 
         if (baseColor.a < 0.5f)
-            return;
-        if ((frame->zBuffer[index] < f.z) || f.z<0)
-            return;
+            return false;
         float previousZ = frame->zBuffer[index];
-        if(!(defer && tri.mat->flags.transparent))
+        bool writesZ = mode != DrawMode::DepthEqual && mode != DrawMode::WeightedBlended && !(defer && tri.mat->flags.transparent);
+        if(writesZ)
             frame->zBuffer[index] = f.z;
 
-        if (defer) {
-            if (tri.mat->flags.transparent) {
-                uint32_t &currentHead = frame->transparencyHeads[index];
-                uint32_t prev = UINT32_MAX;
-                uint32_t current = currentHead;
-            
-                // Traverse the linked list to find the correct insertion point (z descending)
-                while (current != UINT32_MAX && frame->transparencyFragments[current].f.z > f.z) {
-                    prev = current;
-                    current = frame->transparencyFragments[current].next;
-                }
-            
-                // Insert fragment
-                frame->transparencyFragments.push_back(FragmentNode{f, current});
-                uint32_t newIndex = frame->transparencyFragments.size() - 1;
-            
-                // Update the linked list pointers
-                if (prev == UINT32_MAX) { // inserted at front of list, have to update head
-                    currentHead = newIndex;
-                } else { // Inserted in the middle or end of the list
-                    frame->transparencyFragments[prev].next = newIndex;
-                }
-            }
+        if (mode == DrawMode::DepthOnly) {
+            return writesZ;
+        } else if (mode == DrawMode::Visibility) {
+            frame->visibility[index] = triangleId;
+        } else if (mode == DrawMode::WeightedBlended) {
+            Color transmittance = tri.mat->transmittance(f);
+            float coverage = 1 - (transmittance.r + transmittance.g + transmittance.b) / 3;
+            Color color = scene->fullBright ? baseColor : tri.mat->shade(f, Color{0, 0, 0, 0}, *scene);
+            float weight = coverage * weightedBlendedDepthWeight(f.z);
+            color.a = coverage;
+            frame->transparencyAccumulation[index] += color * weight;
+            frame->transparencyRevealage[index] *= transmittance;
+        } else if (defer) {
+            if (tri.mat->flags.transparent)
+                frame->addTransparentFragment(index, f);
+            else if (frame->gBufferLayout == GBufferLayout::Packed)
+                frame->packedGBuffer.store(index, f);
             else
                 frame->gBuffer[index] = f;
         } else {
@@ -198,37 +358,62 @@ void drawTriangle(Camera *camera, Triangle tri, bool defer) {
                 baseColor :
                 tri.mat->shade(f, frame->framebuffer[index], *scene);
         }
+        return writesZ;
     };
 
-    float minY = min({a.y, b.y, c.y});
-    float maxY = max({a.y, b.y, c.y});
-    float minX = min({a.x, b.x, c.x});
-    float maxX = max({a.x, b.x, c.x});
-
-    for (int y = minY; y < maxY; y+=2) {
-        for (int x = minX; x < maxX; x+=2) {
-            Fragment f1 = getFragment({x  ,y  });
-            Fragment f2 = getFragment({x+1,y  });
-            Fragment f3 = getFragment({x  ,y+1});
-            Fragment f4 = getFragment({x+1,y+1});
-            f1.dUVdx = f2.uv - f1.uv;
-            f2.dUVdx = f2.uv - f1.uv;
-            f3.dUVdx = f4.uv - f3.uv;
-            f4.dUVdx = f4.uv - f3.uv;
-            f1.dUVdy = f3.uv - f1.uv;
-            f3.dUVdy = f3.uv - f1.uv;
-            f2.dUVdy = f4.uv - f2.uv;
-            f4.dUVdy = f4.uv - f2.uv;
-            postFragment(f1);
-            postFragment(f2);
-            postFragment(f3);
-            postFragment(f4);
+    // Only covered pixels that pass the depth test become fragments. The triangle is walked in hi-Z blocks,
+    // and within each block edge functions are tested rasterLanes pixels at a time.
+    constexpr int blockSize = RenderTarget::hiZBlockSize;
+    static_assert(blockSize % rasterLanes == 0);
+    if (setup.area != 0) {
+        for (int by = min.y / blockSize; by * blockSize < max.y; by++) {
+            for (int bx = min.x / blockSize; bx * blockSize < max.x; bx++) {
+                DepthRange block = frame->hiZ[bx + by * frame->hiZCount.x];
+                if (zMin > block.max) // Occluded
+                    continue;
+                bool alwaysInFront = zMax < block.min && mode != DrawMode::DepthEqual;
+                bool depthWritten = false;
+
+                int x0 = std::max(bx * blockSize, min.x), x1 = std::min((bx + 1) * blockSize, max.x);
+                int y0 = std::max(by * blockSize, min.y), y1 = std::min((by + 1) * blockSize, max.y);
+                for (int y = y0; y < y1; y++) {
+                    float py = y + 0.5f;
+                    for (int x = x0; x < x1; x += rasterLanes) {
+                        float px = x + 0.5f;
+                        uint32_t mask = coverageMask(C1.at(px, py), C2.at(px, py), C3.at(px, py), C1.dx, C2.dx, C3.dx);
+                        if (x1 - x < rasterLanes)
+                            mask &= (1u << (x1 - x)) - 1;
+                        while (mask) {
+                            int lane = std::countr_zero(mask);
+                            mask &= mask - 1;
+                            Vector2i p{x + lane, y};
+                            float z = setup.depth({p.x + 0.5f, py});
+                            float &zBuffer = frame->zBuffer[p.x + p.y * frame->size.x];
+                            if (z < 0 || (!alwaysInFront && zBuffer < z))
+                                continue;
+                            if (mode == DrawMode::DepthEqual && zBuffer != z) // Something else is visible here
+                                continue;
+                            if ((mode == DrawMode::DepthOnly || mode == DrawMode::Visibility) && !tri.mat->flags.alphaCutout) {
+                                zBuffer = z;
+                                if (mode == DrawMode::Visibility)
+                                    frame->visibility[p.x + p.y * frame->size.x] = triangleId;
+                                depthWritten = true;
+                                continue;
+                            }
+                            Fragment f = setup.fragment(p, z);
+                            depthWritten |= postFragment(f);
+                        }
+                    }
+                }
+                if (depthWritten)
+                    frame->updateHiZ(bx, by);
+            }
         }
     }
 
-    if (scene->wireFrame) {
-        drawLine(a, b, frame);
-        drawLine(c, b, frame);
-        drawLine(a, c, frame);
+    if (scene->wireFrame && mode != DrawMode::DepthOnly) {
+        drawLine(a, b, frame, min, max);
+        drawLine(c, b, frame, min, max);
+        drawLine(a, c, frame, min, max);
     }
 }
\ No newline at end of file
@@ -10,5 +10,40 @@
 using sf::Vector2f, sf::Vector2u, sf::Vector2i;
 using std::swap, std::max, std::abs;
 
-void drawTriangle(Camera *camera, Triangle tri, bool defer);
+// A value that changes linearly across the screen: x * dx + y * dy + c
+struct ScreenPlane {
+    float dx, dy, c;
+    float at(float x, float y) const { return x * dx + y * dy + c; }
+    float at(Vector2f p) const { return at(p.x, p.y); }
+    ScreenPlane operator*(float s) const { return {dx * s, dy * s, c * s}; }
+    ScreenPlane operator+(const ScreenPlane &o) const { return {dx + o.dx, dy + o.dy, c + o.c}; }
+};
+
+// Everything about a triangle that doesn't change between its pixels.
+// Used for rasterizing, and for rebuilding fragments from a visibility buffer.
+struct TriangleSetup {
+    Triangle *tri;
+    Vector2f a, b, c; // Vertices in pixels
+    float area;
+    ScreenPlane C1, C2, C3; // Barycentric coordinates
+    Vec3 invZ;
+    ScreenPlane W, U, V; // 1/z, u/z, v/z
+    Vec3 triangleNormal, tangent, bitangent;
+
+    TriangleSetup(Camera *camera, Triangle &tri);
+    // Perspective-correct z is cheap, so the depth test can be done before interpolating anything else
+    float depth(Vector2f pixelCenter) const;
+    Fragment fragment(Vector2i pixel, float z) const;
+};
+
+// Clips the triangle against the near plane and the guard band. Returns false if it doesn't need clipping,
+// otherwise appends the pieces (possibly none) to out.
+bool clipTriangle(Camera *camera, Triangle &tri, std::vector<Triangle> &out);
+// Returns false if the triangle is culled, otherwise writes its pixel bounding box (clamped to the frame, max exclusive)
+bool triangleScreenBounds(Camera *camera, Triangle &tri, Vector2i &min, Vector2i &max);
+// Rasterizes only the pixels inside [min, max). Doesn't cull, use triangleScreenBounds first.
+// The hi-Z tests cover the whole rect, so it should be the triangle's bounds, or their overlap with a tile.
+// triangleId is what Visibility mode writes to the visibility buffer, see Camera::opaqueTriangle.
+void drawTriangle(Camera *camera, Triangle &tri, DrawMode mode, Vector2i min, Vector2i max, uint32_t triangleId);
+void drawTriangle(Camera *camera, Triangle tri, DrawMode mode); // Not for Visibility mode
 #endif /* __TRIANGLE_H__ */